@@ -20,6 +20,7 @@
 #include "Message.h"
 #include "PumpSwitch.h"
 #include "TankSensors.h"
+#include "Transport.h"
 #include "WAN.h"
 
 /*
@@ -57,18 +58,32 @@
 // XBee will use SoftwareSerial for communications, reserve the HardwareSerial
 // for debugging w/FTDI interface.
 SoftwareSerial ss(SS_RX_PIN, SS_TX_PIN);
+SoftwareSerialTransport transport(ss);
 
 LED statusLed = LED(STATUS_LED);
 
-WAN wan = WAN(ss, statusLed);
+WAN wan = WAN(transport, statusLed);
 
 void setupWAN() {
     // software serial is used for XBee communications
     pinMode(SS_RX_PIN, INPUT);
     pinMode(SS_TX_PIN, OUTPUT);
-    ss.begin(9600);
+    transport.begin(XBEE_BAUD_RATE_DEFAULT);
 
     wan.setup();
+
+    // less time on the wire for every frame, at 9600 if the XBee
+    // can't be switched
+    wan.negotiateBaudRate(XBEE_BAUD_RATE);
+
+    // the remote sensor must re-join if these are too short,
+    // mismatches are logged and fixed as the responses arrive
+    wan.verifySetting("SP", XBEE_COORDINATOR_SLEEP_PERIOD);
+    wan.verifySetting("SN", XBEE_COORDINATOR_SLEEP_COUNT);
+
+    // the coordinator finds any nodes not at the default addresses,
+    // they're registered as the responses are received
+    wan.discoverNodes();
 }
 
 /*
@@ -185,42 +200,179 @@ void disablePump() {
     display.scroll("PUMP STOPPED");
 }
 
-void receive() {
-    Data data = Data();
-    if (wan.receive(data)) {
-        Serial.println(F("Received data..."));
-        Serial.flush();
-
-        if (wan.isBaseStationAddress(data.getAddress())) {
-            Serial.println(F("New data from Base Station"));
-            // we're the base station, this would be weird
-        } else if (wan.isRemoteSensorAddress(data.getAddress())) {
+/*
+ * The remote sensor sleeps, commands are held by WAN and
+ * sent when it next polls for them (with its next report).
+ */
+void requestSensorReport(uint32_t address) {
+    uint8_t command = SENSOR_COMMAND_REPORT;
+
+    Data frame = Data();
+    frame.setAddress(address);
+    wan.addMessage(frame, MESSAGE_TYPE_SENSOR_COMMAND, &command, 1);
+
+    if (wan.transmitDownlink(&frame)) {
+        Serial.println(F("Requested Remote Sensor report"));
+    }
+}
+
+/*
+ * Message handlers, called by WAN for each message received.
+ */
+void receiveSensorFrame(uint8_t type, Data &message) {
+    Serial.println(F("New sensor frame from Remote Sensor"));
+    tankSensors.updateFrame(type, message);
+
+    // a rejected delta leaves the values unknown, they're
+    // only current once a frame has been applied
+    if (tankSensors.ready()) {
+        lastRemoteSensorReceiveTime = millis();
+        Serial.println(F("Updated Tank Sensor values"));
+    }
+
+    // a frame was missed (or we just started), ask for a key
+    // frame rather than waiting for the next periodic one
+    if (!tankSensors.ready()) {
+        requestSensorReport(message.getAddress());
+    }
+}
+
+// float switches wired straight to a remote sensor XBee's DIO pins,
+// sampled on change (IC) and periodically (IR), see notes/radios.md
+void receiveSensorSamples(uint8_t type, Data &message) {
+    if (WAN_ROLE_REMOTE_SENSOR != wan.getRole(message.getAddress())) {
+        Serial.println(F("IO sample from unknown node, ignored"));
+        return;
+    }
+
+    uint8_t* sample = message.getData();
+    if (WAN_IO_SAMPLE_DIGITAL_SIZE > message.getSize()) {
+        return;
+    }
+
+    uint16_t mask = ((uint16_t)sample[0] << 8) | sample[1];
+    uint16_t values = ((uint16_t)sample[2] << 8) | sample[3];
+
+    Serial.println(F("New IO sample from Remote Sensor"));
+    tankSensors.updateSamples(mask, values);
+    lastRemoteSensorReceiveTime = millis();
+    Serial.println(F("Updated Tank Sensor values"));
+}
+
+// update the local PumpSwitch object, the remote switch is always
+// the authority for the values & settings
+void receivePumpValues(uint8_t type, Data &message) {
+    pumpSwitch.updateValues(message.getData(), message.getSize());
+    lastPumpSwitchValuesReceiveTime = millis();
+    Serial.println(F("Updated Pump Switch values"));
+}
+
+void receivePumpSettings(uint8_t type, Data &message) {
+    pumpSwitch.updateSettings(message.getData(), message.getSize());
+    lastPumpSwitchSettingsReceiveTime = millis();
+    Serial.println(F("Updated Pump Switch settings"));
+}
+
+// link statistics from the other nodes, to compare
+// their airtime and battery use
+void receiveStats(uint8_t type, Data &message) {
+    WANStats stats;
+    if (!wan.readStats(message, stats)) {
+        Serial.println(F("Invalid stats, ignored"));
+        return;
+    }
+
+    uint16_t failures = 0;
+    for (uint8_t i = 0; i < WAN_STATS_TX_FAILURES; i++) {
+        failures += stats.txFailures[i];
+    }
+
+    Serial.print(F("Stats from node role: "));
+    Serial.print(wan.getRole(message.getAddress()));
+    Serial.print(F(" sent: "));
+    Serial.print(stats.sent);
+    Serial.print(F(" failed: "));
+    Serial.print(failures);
+    Serial.print(F(" received: "));
+    Serial.print(stats.received);
+    Serial.print(F(" receive errors: "));
+    Serial.print(stats.checksumErrors + stats.startByteErrors + stats.receiveDropped + stats.transportOverflows);
+    Serial.print(F(" wake avg (ms): "));
+    Serial.print(stats.wakeAvg);
+    Serial.print(F(" awake (s): "));
+    Serial.println(stats.awakeMillis / 1000UL);
+}
+
+/*
+ * Data from older firmware doesn't have message headers, the
+ * sender and size of the data determine what it is.
+ */
+void receiveLegacy(uint8_t type, Data &data) {
+    switch (wan.getRole(data.getAddress())) {
+        case WAN_ROLE_REMOTE_SENSOR:
             Serial.println(F("New data from Remote Sensor"));
-            if (tankSensors.getNumSensors() == data.getSize()) {
+            if (tankSensors.isSensorData(data)) {
                 tankSensors.update(data);
                 lastRemoteSensorReceiveTime = millis();
                 Serial.println(F("Updated Tank Sensor values"));
             }
-        } else if (wan.isPumpSwitchAddress(data.getAddress())) {
+            break;
+        case WAN_ROLE_PUMP_SWITCH:
             Serial.println(F("New data from Pump Switch"));
-            // update the local PumpSwitch object, the remote switch is always
-            // the authority for the values & settings
             if (pumpSwitch.getNumSettings() == data.getSize()) {
-                pumpSwitch.updateSettings(data.getData(), data.getSize());
-                lastPumpSwitchSettingsReceiveTime = millis();
-                Serial.println(F("Updated Pump Switch settings"));
+                receivePumpSettings(type, data);
             } else if (pumpSwitch.getNumValues() == data.getSize()) {
-                pumpSwitch.updateValues(data.getData(), data.getSize());
-                lastPumpSwitchValuesReceiveTime = millis();
-                Serial.println(F("Updated Pump Switch values"));
+                receivePumpValues(type, data);
             }
-        }
+            break;
+    }
+}
 
-        for (uint8_t i = 0; i < data.getSize(); i++) {
-            Serial.print(i);
-            Serial.print(F(":\t"));
-            Serial.println(data.getData()[i]);
-        }
+/*
+ * Called once a reliable transmit completes, only those to the
+ * Pump Switch are reported (others are downlinks to the Remote
+ * Sensor).
+ *
+ * If the Pump Switch never received the update it will continue
+ * to send its own (authoritative) values, which will reset the
+ * local PumpSwitch to match.
+ */
+void pumpSwitchDelivery(uint8_t frameId, uint32_t address, uint8_t status) {
+    if (!wan.isPumpSwitchAddress(address)) {
+        return;
+    }
+
+    if (SUCCESS == status) {
+        Serial.println(F("PumpSwitch data delivered"));
+    } else {
+        Serial.print(F("PumpSwitch data NOT delivered, status: "));
+        Serial.println(status);
+        display.scroll("PUMP NOT UPDATED");
+    }
+}
+
+void setupHandlers() {
+    wan.setHandler(WAN_MESSAGE_TYPE_LEGACY,    receiveLegacy);
+    wan.setHandler(MESSAGE_TYPE_SENSOR_KEY,    receiveSensorFrame);
+    wan.setHandler(MESSAGE_TYPE_SENSOR_DELTA,  receiveSensorFrame);
+    wan.setHandler(MESSAGE_TYPE_PUMP_VALUES,   receivePumpValues);
+    wan.setHandler(MESSAGE_TYPE_PUMP_SETTINGS, receivePumpSettings);
+    wan.setHandler(WAN_MESSAGE_TYPE_IO_SAMPLE, receiveSensorSamples);
+    wan.setHandler(WAN_MESSAGE_TYPE_STATS,     receiveStats);
+
+    wan.setDeliveryCallback(pumpSwitchDelivery);
+
+    // only the latest pump values need to reach the pump switch
+    wan.setStateMessage(MESSAGE_TYPE_PUMP_VALUES);
+}
+
+void receive() {
+    // handle every frame received since the last loop, idling
+    // briefly if there aren't any yet
+    uint8_t received = wan.receiveAll(RECEIVE_IDLE_TIMEOUT_MS);
+    if (received) {
+        Serial.print(F("Received frames: "));
+        Serial.println(received);
 
         freeRam(FREE_RAM_ENABLE);
     }
@@ -229,9 +381,14 @@ void receive() {
 void transmit() {
     uint32_t start = millis();
 
-    Data values = Data(wan.getPumpSwitchAddress(), pumpSwitch.getValues(), pumpSwitch.getNumValues());
+    Data frame = Data();
+    frame.setAddress(wan.getPumpSwitchAddress());
+    wan.addMessage(frame, MESSAGE_TYPE_PUMP_VALUES, pumpSwitch.getValues(), pumpSwitch.getNumValues());
     
-    if (wan.transmit(&values)) {
+    // pump commands are retried until the pump switch receives them,
+    // ahead of anything else queued, see pumpSwitchDelivery() for
+    // the result.
+    if (wan.transmitReliable(&frame, WAN_PRIORITY_HIGH)) {
         Serial.println(F("PumpSwitch data sent!"));
     } else {
         Serial.println(F("Failed to transmit Pump Switch data"));
@@ -300,6 +457,8 @@ void setup() {
 
     setupWAN();
 
+    setupHandlers();
+
     setupEvaluate();
 
     Serial.println(F("setup() completed!"));
@@ -10,12 +10,37 @@
 #define REMOTE_SENSOR_CHECK_INTERVAL_SECONDS 300UL // 5 minutes
 // How often to transmit values, regardless of previous sensor values
 #define REMOTE_SENSOR_FORCE_TRANSMIT_INTERVAL_SECONDS 1800UL // 30 minutes
+// Shortest check interval the base station can change it to
+#define REMOTE_SENSOR_MIN_CHECK_INTERVAL_SECONDS 10UL
 
 // How long WAN should wait for data when receiving
 // before giving up.
-#define REMOTE_SENSOR_RECEIVE_TIMEOUT_MS 0UL // 0 seconds - don't wait for timeout max, just check once
+#define REMOTE_SENSOR_RECEIVE_TIMEOUT_MS 100UL // wait up to 100ms per read for the TX status
 
-// How often to transmit values
+// Base station and pump switch loops idle (the MCU sleeps) up to
+// this long waiting for frames, short enough for the buttons to
+// still be debounced (5ms).
+#define RECEIVE_IDLE_TIMEOUT_MS 5UL
+
+// How often the remote sensor and pump switch send their
+// link statistics (WAN_MESSAGE_TYPE_STATS) to the base station
+#define STATS_TRANSMIT_INTERVAL_MINUTES 60UL
+
+// Longest to wait for the XBee to join the network at startup
+#define REMOTE_SENSOR_JOIN_TIMEOUT_MS 30000UL // 30 seconds
+
+// Transmit power (PL 0-4) is lowered one step after a run of reports
+// over a strong link (a recent RSSI is needed), and raised again as
+// soon as retries climb or a transmit fails.
+// Retries are the average per transmit in 1/16ths, RSSI is -dBm.
+#define REMOTE_SENSOR_POWER_LEVEL_MIN     0
+#define REMOTE_SENSOR_POWER_LEVEL_MAX     4
+#define REMOTE_SENSOR_POWER_RAISE_RETRIES 16 // 1 retry per transmit
+#define REMOTE_SENSOR_POWER_LOWER_RETRIES 2  // 1 retry per 8 transmits
+#define REMOTE_SENSOR_POWER_LOWER_RSSI    70 // -70dBm or stronger
+#define REMOTE_SENSOR_POWER_LOWER_REPORTS 8  // in a row, before each step down
+
+// How often to transmit values & settings (together, in one frame)
 #define PUMP_SWITCH_TRANSMIT_INTERVAL_SECONDS 15UL
 
 #define PUMP_DEFAULT_MAX_ON_MINUTES   45UL
@@ -29,6 +54,24 @@
 #define PUMP_SWITCH_RECEIVE_ALARM_DELAY_MINUTES 1UL
 #define REMOTE_SENSOR_RECEIVE_ALARM_DELAY_MINUTES 35UL
 
+// Message types exchanged between the stations, see WAN.h
+// for the message format. Type 0 is reserved for data from
+// older firmware that didn't use message headers, type 13 for
+// downlink polls (WAN_MESSAGE_TYPE_DOWNLINK), type 14 for link
+// statistics (WAN_MESSAGE_TYPE_STATS) and type 15 for XBee IO
+// samples (WAN_MESSAGE_TYPE_IO_SAMPLE).
+#define MESSAGE_TYPE_SENSOR_KEY    1
+#define MESSAGE_TYPE_SENSOR_DELTA  2
+#define MESSAGE_TYPE_PUMP_VALUES   3
+#define MESSAGE_TYPE_PUMP_SETTINGS 4
+#define MESSAGE_TYPE_SENSOR_COMMAND 5
+
+// Commands sent to the remote sensor, only received after it
+// transmits (see WAN::transmitDownlink()):
+//   [COMMAND][ARGUMENTS...]
+#define SENSOR_COMMAND_REPORT   1 // send a key frame now
+#define SENSOR_COMMAND_INTERVAL 2 // [SECONDS MSB][SECONDS LSB] check interval
+
 void freeRam(bool enable = false);
 
 #endif //Danaides_h
@@ -5,54 +5,135 @@
  * Private
  */
 
-void Data::_init(uint32_t address, uint8_t* data, uint8_t size) {
+bool Data::_init(uint32_t address, uint8_t* data, uint8_t size) {
+    bool truncated = false;
+    if (DATA_MAX_SIZE < size) {
+        size = DATA_MAX_SIZE;
+        truncated = true;
+    }
+
     _address = address;
     _size = size;
+    _borrowed = false;
 
-    if (_initialized) {
-        // delete the old data before allocating more
-        delete [] _data;
+    // make a copy of the data, memmove() because the
+    // source may be our own buffer
+    if (data && _buffer != data) {
+        memmove(_buffer, data, _size);
     }
 
-    // make a copy of the data
-    _data = new uint8_t[_size];
-    for (uint8_t i = 0; i < _size; i++) {
-        _data[i] = data[i];
-    }
+    _data = _buffer;
 
-    _initialized = true;
+    return !truncated;
+}
+
+void Data::_borrow(uint32_t address, uint8_t* data, uint8_t size) {
+    _address = address;
+    _data = data;
+    _size = size;
+    _borrowed = true;
 }
 
 /*
  * Public
  */
 
-Data::Data() : _initialized(false), 
-               _address(0), 
-               _data(NULL),
-               _size(0) {
+Data::Data() : _address(0),
+               _data(_buffer),
+               _size(0),
+               _borrowed(false) {
 }
 
-Data::Data(uint8_t *data, uint8_t size) : _initialized(false) {
+Data::Data(uint8_t *data, uint8_t size) {
     _init(0UL, data, size);
 }
 
-Data::Data(uint32_t address, uint8_t *data, uint8_t size) : _initialized(false) {
+Data::Data(uint32_t address, uint8_t *data, uint8_t size) {
     _init(address, data, size);
 }
 
+/*
+ * Copies share borrowed data, but own a copy of owned data.
+ */
+Data::Data(const Data &other) {
+    if (other._borrowed) {
+        _borrow(other._address, other._data, other._size);
+    } else {
+        _init(other._address, other._data, other._size);
+    }
+}
+
 Data::~Data() {
-    if (_initialized) {
-        delete [] _data;
+}
+
+Data& Data::operator=(const Data &other) {
+    if (this != &other) {
+        if (other._borrowed) {
+            _borrow(other._address, other._data, other._size);
+        } else {
+            _init(other._address, other._data, other._size);
+        }
     }
+
+    return *this;
 }
 
-void Data::set(uint8_t *data, uint8_t size) {
-    _init(0UL, data, size);
+bool Data::set(uint8_t *data, uint8_t size) {
+    return _init(0UL, data, size);
 }
 
-void Data::set(uint32_t address, uint8_t *data, uint8_t size) {
-    _init(address, data, size);
+bool Data::set(uint32_t address, uint8_t *data, uint8_t size) {
+    return _init(address, data, size);
+}
+
+void Data::borrow(uint8_t *data, uint8_t size) {
+    _borrow(0UL, data, size);
+}
+
+void Data::borrow(uint32_t address, uint8_t *data, uint8_t size) {
+    _borrow(address, data, size);
+}
+
+bool Data::append(uint8_t *data, uint8_t size) {
+    if (DATA_MAX_SIZE - _size < size) {
+        return false;
+    }
+
+    if (_borrowed) {
+        _init(_address, _data, _size);
+    }
+
+    memcpy(_buffer + _size, data, size);
+    _size += size;
+
+    return true;
+}
+
+void Data::move(Data &other) {
+    if (this == &other) {
+        return;
+    }
+
+    if (other._borrowed) {
+        // only the reference moves
+        _borrow(other._address, other._data, other._size);
+    } else {
+        // inline storage can't change hands, copy it
+        _init(other._address, other._data, other._size);
+    }
+
+    other.clear();
+}
+
+void Data::clear() {
+    _address = 0UL;
+    _data = _buffer;
+    _size = 0;
+    _borrowed = false;
+}
+
+void Data::setAddress(uint32_t address) {
+    _address = address;
 }
 
 uint8_t* Data::getData() {
@@ -63,6 +144,10 @@ uint8_t Data::getSize() {
     return _size;
 }
 
+uint8_t Data::getCapacity() {
+    return DATA_MAX_SIZE;
+}
+
 uint32_t Data::getAddress() {
     return _address;
 }
@@ -71,3 +156,6 @@ bool Data::hasAddress() {
     return _address;
 }
 
+bool Data::isBorrowed() {
+    return _borrowed;
+}
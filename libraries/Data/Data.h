@@ -8,30 +8,68 @@
  * Constants
  */
 
+// Maximum number of bytes that can be stored inline, data
+// larger than this is truncated. Sized for the largest
+// message exchanged between the stations, not the largest
+// XBee payload.
+#define DATA_MAX_SIZE 32
+
+/*
+ * Data never allocates from the heap, it either holds a copy
+ * of the data in its own fixed-size buffer (owned), or points
+ * at a buffer owned by the caller (borrowed).
+ *
+ * Borrowed data is never copied, the caller must keep the
+ * buffer alive (and unchanged) for as long as the Data is used.
+ */
 class Data {
     private:
-        bool _initialized;
-
         uint32_t _address;
-        uint8_t*  _data;
-        uint8_t   _size;
+        uint8_t* _data;
+        uint8_t  _size;
+        bool     _borrowed;
+
+        uint8_t  _buffer[DATA_MAX_SIZE];
 
-        void _init(uint32_t address, uint8_t* data, uint8_t size);
+        bool _init(uint32_t address, uint8_t* data, uint8_t size);
+        void _borrow(uint32_t address, uint8_t* data, uint8_t size);
 
     public:
         Data();
         Data(uint8_t* data, uint8_t size);
         Data(uint32_t address, uint8_t* data, uint8_t size);
+        Data(const Data &other);
         ~Data();
 
-        void set(uint8_t* data, uint8_t size);
-        void set(uint32_t address, uint8_t* data, uint8_t size);
+        Data& operator=(const Data &other);
+
+        // copy the data into the inline buffer, returns
+        // false if the data was truncated to DATA_MAX_SIZE
+        bool set(uint8_t* data, uint8_t size);
+        bool set(uint32_t address, uint8_t* data, uint8_t size);
+
+        // reference the caller's buffer without copying it
+        void borrow(uint8_t* data, uint8_t size);
+        void borrow(uint32_t address, uint8_t* data, uint8_t size);
+
+        // copy the data onto the end of the inline buffer (borrowed
+        // data is copied first), returns false if there isn't room
+        bool append(uint8_t* data, uint8_t size);
+
+        // take the contents of other, leaving other empty
+        void move(Data &other);
+
+        void clear();
+
+        void setAddress(uint32_t address);
 
         uint32_t getAddress();
         uint8_t* getData();
         uint8_t  getSize();
+        uint8_t  getCapacity();
 
         bool     hasAddress();
+        bool     isBorrowed();
 };
 
 #endif //Data_h
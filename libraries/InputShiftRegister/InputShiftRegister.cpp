@@ -41,14 +41,20 @@ void InputShiftRegister::getInputValues(Data &data) {
     digitalWrite(_plPin, HIGH);
     digitalWrite(_cePin, LOW);
 
-    uint8_t values[_numInputs];
+    // pack the values, 8 inputs per byte with input N
+    // at bit (N % 8) of byte (N / 8)
+    uint8_t values[getNumInputBytes()];
+    memset(values, 0, sizeof(values));
+
     for (uint8_t i = 0; i < _numInputs; i++) {
         // order of values returned from the shift register
         // is from 32 -> 1, so need to revese & offset them
         // for index use.
         uint8_t index = _numInputs - i - 1;
         
-        values[index] = digitalRead(_q7Pin);
+        if (digitalRead(_q7Pin)) {
+            values[index / 8] |= 1 << (index % 8);
+        }
 
         // pulse the clock to load the next input value
         digitalWrite(_cpPin, HIGH);
@@ -56,10 +62,15 @@ void InputShiftRegister::getInputValues(Data &data) {
         digitalWrite(_cpPin, LOW);
     }
 
-    data.set(values, _numInputs);
+    data.set(values, sizeof(values));
 }
 
 uint8_t InputShiftRegister::getNumInputs() {
     return _numInputs;
 }
 
+uint8_t InputShiftRegister::getNumInputBytes() {
+    // a partial byte for the last inputs
+    return (_numInputs + 7) / 8;
+}
+
@@ -29,8 +29,10 @@ class InputShiftRegister {
 
         void setup();
 
+        // values are packed 8 inputs per byte
         void    getInputValues(Data &data);
         uint8_t getNumInputs();
+        uint8_t getNumInputBytes();
 };
 
 #endif //InputShiftRegister_h
@@ -6,8 +6,8 @@
 LED::LED() :
     _pin(0),
     _enabled(true),
-    _on(false),
     _currLedState(false),
+    _on(false),
     _maxFlashCount(0),
     _currFlashCount(0),
     _flashDelayMs(0UL),
@@ -19,8 +19,8 @@ LED::LED() :
 LED::LED(uint8_t pin) :
     _pin(pin),
     _enabled(true),
-    _on(false),
     _currLedState(false),
+    _on(false),
     _maxFlashCount(0),
     _currFlashCount(0),
     _flashDelayMs(0UL),
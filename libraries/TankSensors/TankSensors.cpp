@@ -9,12 +9,40 @@
  * Private
  */
 
+bool TankSensors::_getSensorValue(uint8_t sensorIndex) {
+    return _sensors[sensorIndex / 8] & (1 << (sensorIndex % 8));
+}
+
+bool TankSensors::_setSensorValues(uint8_t* sensors) {
+    bool changed = false;
+    for (uint8_t i = 0; i < SENSOR_TOTAL_BYTES; i++) {
+        if (_sensors[i] != sensors[i]) {
+            changed = true;
+        } 
+
+        _sensors[i] = sensors[i];
+    }
+
+    _initialized = true;
+
+    return changed;
+}
+
 /*
  * Public
  */
 
 TankSensors::TankSensors() :
-    _initialized(false) {
+    _initialized(false),
+    _sequence(0),
+    _ackedSequence(0),
+    _acked(false),
+    _pendingSequence(0),
+    _pending(false) {
+
+    memset(_sensors, 0, sizeof(_sensors));
+    memset(_ackedSensors, 0, sizeof(_ackedSensors));
+    memset(_pendingSensors, 0, sizeof(_pendingSensors));
 }
 
 TankSensors::~TankSensors() {
@@ -24,6 +52,10 @@ uint8_t* TankSensors::getSensorValues() {
     return _sensors;
 }
 
+uint8_t TankSensors::getNumSensorBytes() {
+    return SENSOR_TOTAL_BYTES;
+}
+
 uint8_t TankSensors::getNumSensors() {
     return SENSOR_TOTAL_INPUTS;
 }
@@ -44,19 +76,167 @@ bool TankSensors::ready() {
     return _initialized;
 }
 
+bool TankSensors::isSensorData(Data &data) {
+    if (SENSOR_TOTAL_BYTES == data.getSize()) {
+        return true;
+    }
+
+    if (SENSOR_TOTAL_INPUTS == data.getSize()) {
+        // older remote sensors send one byte per sensor
+        return true;
+    }
+
+    return false;
+}
+
 bool TankSensors::update(Data &data) {
-    bool changed = false;
-    for (uint8_t i = 0; i < data.getSize(); i++) {
-        if (_sensors[i] != data.getData()[i]) {
-            changed = true;
-        } 
+    if (SENSOR_TOTAL_BYTES == data.getSize()) {
+        return _setSensorValues(data.getData());
+    }
+
+    if (SENSOR_TOTAL_INPUTS == data.getSize()) {
+        // older remote sensors send one byte per sensor,
+        // pack them to match the current format
+        uint8_t sensors[SENSOR_TOTAL_BYTES];
+        memset(sensors, 0, sizeof(sensors));
+        for (uint8_t i = 0; i < SENSOR_TOTAL_INPUTS; i++) {
+            if (data.getData()[i]) {
+                sensors[i / 8] |= 1 << (i % 8);
+            }
+        }
 
-        _sensors[i] = data.getData()[i];
+        return _setSensorValues(sensors);
     }
 
-    _initialized = true;
+    Serial.print(F("Unknown sensor data size: "));
+    Serial.println(data.getSize());
+    return false;
+}
 
-    return changed;
+bool TankSensors::updateFrame(uint8_t type, Data &data) {
+    uint8_t* frame = data.getData();
+
+    if (MESSAGE_TYPE_SENSOR_KEY == type) {
+        if (SENSOR_FRAME_KEY_SIZE != data.getSize()) {
+            Serial.print(F("Unknown sensor key frame size: "));
+            Serial.println(data.getSize());
+            return false;
+        }
+
+        _sequence = frame[0];
+        return _setSensorValues(frame + 1);
+    }
+
+    if (MESSAGE_TYPE_SENSOR_DELTA != type || SENSOR_FRAME_DELTA_HEADER_SIZE > data.getSize()) {
+        Serial.print(F("Unknown sensor frame type: "));
+        Serial.println(type);
+        return false;
+    }
+
+    // delta frames only apply to the frame they were built from,
+    // otherwise a frame was missed and the sensor values are unknown
+    // until the next key frame arrives.
+    uint8_t baseSequence = frame[1];
+    if (!_initialized || baseSequence != _sequence) {
+        Serial.print(F("Missed sensor frame, waiting for key frame. Expected: "));
+        Serial.print(_sequence);
+        Serial.print(F(" Base: "));
+        Serial.println(baseSequence);
+
+        _initialized = false;
+        return false;
+    }
+
+    uint8_t sensors[SENSOR_TOTAL_BYTES];
+    memcpy(sensors, _sensors, SENSOR_TOTAL_BYTES);
+
+    for (uint8_t i = SENSOR_FRAME_DELTA_HEADER_SIZE; i < data.getSize(); i++) {
+        uint8_t sensorIndex = frame[i];
+        if (SENSOR_TOTAL_INPUTS <= sensorIndex) {
+            Serial.print(F("Unknown sensor index in delta frame: "));
+            Serial.println(sensorIndex);
+            continue;
+        }
+
+        sensors[sensorIndex / 8] ^= 1 << (sensorIndex % 8);
+    }
+
+    _sequence = frame[0];
+    return _setSensorValues(sensors);
+}
+
+/*
+ * Sampled pins use the same packed layout, DIO pin N is bit
+ * (N % 8) of byte (N / 8).
+ */
+bool TankSensors::updateSamples(uint16_t mask, uint16_t values) {
+    uint8_t sensors[SENSOR_TOTAL_BYTES];
+    memcpy(sensors, _sensors, SENSOR_TOTAL_BYTES);
+
+    for (uint8_t i = 0; i < SENSOR_SAMPLE_PINS / 8; i++) {
+        uint8_t pinMask = mask >> (i * 8);
+        uint8_t pinValues = values >> (i * 8);
+        sensors[i] = (sensors[i] & ~pinMask) | (pinValues & pinMask);
+    }
+
+    return _setSensorValues(sensors);
+}
+
+uint8_t TankSensors::getFrame(Data &data, bool keyFrame) {
+    uint8_t frame[SENSOR_FRAME_DELTA_HEADER_SIZE + SENSOR_TOTAL_INPUTS];
+    uint8_t size = 0;
+    uint8_t type = 0;
+
+    _sequence++;
+
+    // find the sensors which toggled since the last delivered frame
+    uint8_t numChanged = 0;
+    if (_acked) {
+        for (uint8_t i = 0; i < SENSOR_TOTAL_INPUTS; i++) {
+            if ((_sensors[i / 8] ^ _ackedSensors[i / 8]) & (1 << (i % 8))) {
+                frame[SENSOR_FRAME_DELTA_HEADER_SIZE + numChanged] = i;
+                numChanged++;
+            }
+        }
+    }
+
+    if (!keyFrame && _acked && SENSOR_FRAME_DELTA_HEADER_SIZE + numChanged < SENSOR_FRAME_KEY_SIZE) {
+        type = MESSAGE_TYPE_SENSOR_DELTA;
+        frame[0] = _sequence;
+        frame[1] = _ackedSequence;
+        size = SENSOR_FRAME_DELTA_HEADER_SIZE + numChanged;
+    } else {
+        type = MESSAGE_TYPE_SENSOR_KEY;
+        frame[0] = _sequence;
+        memcpy(frame + 1, _sensors, SENSOR_TOTAL_BYTES);
+        size = SENSOR_FRAME_KEY_SIZE;
+    }
+
+    memcpy(_pendingSensors, _sensors, SENSOR_TOTAL_BYTES);
+    _pendingSequence = _sequence;
+    _pending = true;
+
+    data.set(frame, size);
+
+    return type;
+}
+
+void TankSensors::acknowledge(bool delivered) {
+    if (!_pending) {
+        return;
+    }
+
+    if (delivered) {
+        memcpy(_ackedSensors, _pendingSensors, SENSOR_TOTAL_BYTES);
+        _ackedSequence = _pendingSequence;
+        _acked = true;
+    } else {
+        // the base station may or may not have the frame, only
+        // a key frame is safe to send next
+        _acked = false;
+    }
+
+    _pending = false;
 }
 
 bool TankSensors::getSensorState(uint8_t sensorIndex) {
@@ -68,10 +248,10 @@ bool TankSensors::getSensorState(uint8_t sensorIndex) {
     }
 
     if (TANK_1_INVERTED_FLOAT == sensorIndex) {
-        return !_sensors[sensorIndex];
+        return !_getSensorValue(sensorIndex);
     }
 
-    return _sensors[sensorIndex];
+    return _getSensorValue(sensorIndex);
 }
 
 bool TankSensors::getValveState(uint8_t valveNumber) {
@@ -112,9 +292,9 @@ bool TankSensors::getFloatState(uint8_t tankNumber, uint8_t floatNumber) {
         return getSensorState(TANK_1_FLOAT_OFFSET + floatNumber);
     } else if (2 == tankNumber) {
         return getSensorState(TANK_2_FLOAT_OFFSET + floatNumber);
-    } else if (3 == tankNumber) {
-        return getSensorState(TANK_3_FLOAT_OFFSET + floatNumber);
     }
+
+    return getSensorState(TANK_3_FLOAT_OFFSET + floatNumber);
 }
 
 bool TankSensors::getTankState(uint8_t tankNumber) {
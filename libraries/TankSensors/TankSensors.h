@@ -2,6 +2,7 @@
 #define TankSensors_h
 
 // local
+#include "Danaides.h"
 #include "Data.h"
 
 /*
@@ -61,21 +62,82 @@
 // (not how many are actually used)
 #define SENSOR_TOTAL_INPUTS 24
 
+// sensor values are packed 8 per byte, sensor N is
+// bit (N % 8) of byte (N / 8)
+#define SENSOR_TOTAL_BYTES (SENSOR_TOTAL_INPUTS / 8)
+
+// Sensor frames sent by the remote sensor, as the payload
+// of the MESSAGE_TYPE_SENSOR_* messages.
+//
+// Key frames contain all the (packed) sensor values:
+//   [SEQUENCE][SENSOR BYTES...]
+//
+// Delta frames contain the indexes of the sensors which
+// toggled since the base frame, the last frame that was
+// acknowledged (delivered) to the base station:
+//   [SEQUENCE][BASE SEQUENCE][SENSOR INDEX...]
+#define SENSOR_FRAME_KEY_SIZE           (1 + SENSOR_TOTAL_BYTES)
+#define SENSOR_FRAME_DELTA_HEADER_SIZE  2
+
+// Float switches can also be wired straight to a remote XBee's
+// DIO pins (no remote sensor board), DIO pin N is sensor N. Only
+// DIO0-7 and DIO10-12 exist, which covers tank 1's floats.
+#define SENSOR_SAMPLE_PINS 16
+
 class TankSensors {
     private:
-        uint8_t _sensors[SENSOR_TOTAL_INPUTS];
+        uint8_t _sensors[SENSOR_TOTAL_BYTES];
 
         bool _initialized;
 
+        // sequence of the last frame sent (remote sensor)
+        // or applied (base station)
+        uint8_t _sequence;
+
+        // sensor values of the last acknowledged frame, and the
+        // frame waiting to be acknowledged (remote sensor only)
+        uint8_t _ackedSensors[SENSOR_TOTAL_BYTES];
+        uint8_t _ackedSequence;
+        bool    _acked;
+        uint8_t _pendingSensors[SENSOR_TOTAL_BYTES];
+        uint8_t _pendingSequence;
+        bool    _pending;
+
+        bool _getSensorValue(uint8_t sensorIndex);
+        bool _setSensorValues(uint8_t* sensors);
+
     public:
         TankSensors();
         ~TankSensors();
 
-        // update the raw sensor values
+        // update the raw sensor values from either the packed
+        // format or the older (unpacked) byte-per-sensor format,
+        // returns true if any sensor value changed.
         bool update(Data &data);
+        bool isSensorData(Data &data);
+
+        // update the sensor values from a received frame,
+        // returns true if any sensor value changed.
+        bool updateFrame(uint8_t type, Data &data);
+
+        // update the sensors sampled by a remote XBee, only the
+        // sensors in the mask are changed. Returns true if any
+        // sensor value changed.
+        bool updateSamples(uint16_t mask, uint16_t values);
+
+        // build a key or delta frame of the current sensor values
+        // for transmitting, a key frame is sent if requested or if
+        // a delta frame would not be any smaller. Returns the
+        // message type of the frame.
+        uint8_t getFrame(Data &data, bool keyFrame);
+
+        // record whether the last frame was delivered, delta frames
+        // are built from the last delivered frame.
+        void acknowledge(bool delivered);
 
-        // return the raw sensor values
+        // return the raw (packed) sensor values
         uint8_t* getSensorValues();
+        uint8_t  getNumSensorBytes();
         uint8_t  getNumSensors();
 
         uint8_t getNumFloatsPerTank();
@@ -0,0 +1,79 @@
+// system
+#include <Arduino.h>
+#include <avr/sleep.h>
+
+// local
+#include "Transport.h"
+
+/*
+ * Transport
+ */
+
+void Transport::idle() {
+    set_sleep_mode(SLEEP_MODE_IDLE);
+
+    // a byte received between checking and sleeping
+    // would wait for the next interrupt
+    cli();
+    if (available()) {
+        sei();
+        return;
+    }
+
+    sleep_enable();
+
+    // sei() only takes effect after the next instruction,
+    // so nothing is handled before sleeping
+    sei();
+    sleep_cpu();
+    sleep_disable();
+}
+
+/*
+ * SoftwareSerialTransport
+ */
+
+SoftwareSerialTransport::SoftwareSerialTransport(SoftwareSerial &serial) : _serial(&serial),
+                                                                         _overflows(0) {
+}
+
+SoftwareSerialTransport::~SoftwareSerialTransport() {
+}
+
+void SoftwareSerialTransport::_checkOverflow() {
+    // the flag is cleared once read
+    if (_serial->overflow()) {
+        _overflows++;
+    }
+}
+
+void SoftwareSerialTransport::begin(uint32_t baud) {
+    _serial->begin(baud);
+}
+
+int SoftwareSerialTransport::available() {
+    _checkOverflow();
+
+    return _serial->available();
+}
+
+int SoftwareSerialTransport::read() {
+    return _serial->read();
+}
+
+int SoftwareSerialTransport::peek() {
+    return _serial->peek();
+}
+
+void SoftwareSerialTransport::flush() {
+}
+
+size_t SoftwareSerialTransport::write(uint8_t b) {
+    return _serial->write(b);
+}
+
+uint16_t SoftwareSerialTransport::getOverflowCount() {
+    _checkOverflow();
+
+    return _overflows;
+}
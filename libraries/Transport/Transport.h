@@ -0,0 +1,64 @@
+#ifndef Transport_h
+#define Transport_h
+
+// system
+#include <Arduino.h>
+#include <SoftwareSerial.h>
+
+/*
+ * A Stream for the XBee link (see WAN), which counts how often
+ * received bytes were dropped because they weren't read quickly
+ * enough (overflows, not the bytes lost).
+ */
+class Transport : public Stream {
+    public:
+        virtual void begin(uint32_t baud) = 0;
+
+        virtual uint16_t getOverflowCount() = 0;
+
+        // sleep the MCU (idle) until the next interrupt, a received
+        // byte or at the latest the next millis() tick (~1ms),
+        // returns straight away if bytes are already waiting
+        void idle();
+
+        using Print::write;
+};
+
+/*
+ * SoftwareSerial keeps its own (interrupt driven) receive buffer,
+ * and only flags that it overflowed, so each check finding the
+ * flag set counts once however many bytes were lost.
+ * Writes block with interrupts disabled for each byte (~1ms at
+ * 9600 baud), and there's no bulk write to save anything on.
+ *
+ * It's the only transport, every sketch has the hardware UART
+ * for its debug console (Serial).
+ */
+class SoftwareSerialTransport : public Transport {
+    private:
+        SoftwareSerial* _serial;
+
+        uint16_t _overflows;
+
+        void _checkOverflow();
+
+    public:
+        SoftwareSerialTransport(SoftwareSerial &serial);
+        ~SoftwareSerialTransport();
+
+        void begin(uint32_t baud);
+
+        int available();
+        int read();
+        int peek();
+
+        // writes are already complete, and SoftwareSerial::flush()
+        // would discard any received bytes
+        void flush();
+
+        size_t write(uint8_t b);
+
+        uint16_t getOverflowCount();
+};
+
+#endif //Transport_h
@@ -4,36 +4,266 @@
 // local
 #include "WAN.h"
 
+/*
+ * Constants
+ */
+
+static const WANTxHeader WAN_TX_HEADERS[] PROGMEM = {
+    { XBEE_BASE_STATION_ADDRESS,  { XBEE_ADDRESS64_BYTES(XBEE_BASE_STATION_ADDRESS) },  XBEE_ADDRESS64_CHECKSUM(XBEE_BASE_STATION_ADDRESS) },
+    { XBEE_REMOTE_SENSOR_ADDRESS, { XBEE_ADDRESS64_BYTES(XBEE_REMOTE_SENSOR_ADDRESS) }, XBEE_ADDRESS64_CHECKSUM(XBEE_REMOTE_SENSOR_ADDRESS) },
+    { XBEE_PUMP_SWITCH_ADDRESS,   { XBEE_ADDRESS64_BYTES(XBEE_PUMP_SWITCH_ADDRESS) },   XBEE_ADDRESS64_CHECKSUM(XBEE_PUMP_SWITCH_ADDRESS) }
+};
+
+// serial rate for each BD value
+static const uint32_t XBEE_BAUD_RATE_TABLE[XBEE_BAUD_RATES] PROGMEM = {
+    1200UL, 2400UL, 4800UL, 9600UL, 19200UL, 38400UL, 57600UL, 115200UL
+};
+
+// stats message values, MSB first
+static void putStat(uint8_t* data, uint8_t &pos, uint32_t value, uint8_t size) {
+    for (uint8_t i = size; i > 0; i--) {
+        data[pos++] = value >> (8 * (i - 1));
+    }
+}
+
+static uint32_t getStat(uint8_t* data, uint8_t &pos, uint8_t size) {
+    uint32_t value = 0UL;
+    for (uint8_t i = 0; i < size; i++) {
+        value = (value << 8) | data[pos++];
+    }
+
+    return value;
+}
+
 /*
  * Private
  */
 
-void WAN::_init(Stream &serial) {
-    _xbee.setSerial(serial);
+void WAN::_init(Transport &transport) {
+    _xbee.setSerial(transport);
+
+    for (uint8_t i = 0; i < WAN_PENDING_SIZE; i++) {
+        _pending[i].frameId = 0;
+    }
+
+    for (uint8_t i = 0; i < WAN_HANDLERS_SIZE; i++) {
+        _handlers[i].handler = NULL;
+    }
+
+    for (uint8_t i = 0; i < WAN_ADDRESS_CACHE_SIZE; i++) {
+        _addresses[i].address = 0UL;
+    }
+    _nextAddress = 0;
+
+    for (uint8_t i = 0; i < WAN_NODES_SIZE; i++) {
+        _nodes[i].address = 0UL;
+    }
+
+    for (uint8_t i = 0; i < WAN_COMMANDS_SIZE; i++) {
+        _commands[i].frameId = 0;
+    }
+
+    for (uint8_t i = 0; i < WAN_DOWNLINK_SIZE; i++) {
+        _downlinks[i].held = false;
+    }
+
+    for (uint8_t i = 0; i < WAN_STATS_TX_FAILURES; i++) {
+        _txFailures[i] = 0;
+    }
+
+    // until discovered, the nodes are where they've always been
+    _registerNode(XBEE_BASE_STATION_ADDRESS, WAN_ROLE_BASE_STATION, 0);
+    _registerNode(XBEE_REMOTE_SENSOR_ADDRESS, WAN_ROLE_REMOTE_SENSOR, 0);
+    _registerNode(XBEE_PUMP_SWITCH_ADDRESS, WAN_ROLE_PUMP_SWITCH, 0);
+}
+
+/*
+ * A message frame is a sequence of messages, each with a
+ * header of this version, whose lengths add up to exactly
+ * the frame size. Anything else is a legacy frame, which
+ * only rarely looks like one (e.g. PumpSwitch settings with
+ * maxOn 0x11-0x1F and minOn 1).
+ */
+bool WAN::_isMessageFrame(Data &frame) {
+    uint8_t* data = frame.getData();
+    uint8_t pos = 0;
+
+    while (pos < frame.getSize()) {
+        if (frame.getSize() - pos < WAN_MESSAGE_HEADER_SIZE) {
+            return false;
+        }
+
+        uint8_t header = data[pos];
+        if (WAN_MESSAGE_TYPE_LEGACY == WAN_MESSAGE_HEADER_TYPE(header) ||
+                WAN_MESSAGE_VERSION != WAN_MESSAGE_HEADER_VERSION(header)) {
+            return false;
+        }
+
+        uint8_t length = data[pos + 1];
+        if (frame.getSize() - pos - WAN_MESSAGE_HEADER_SIZE < length) {
+            return false;
+        }
+
+        pos += WAN_MESSAGE_HEADER_SIZE + length;
+    }
+
+    return 0 < pos;
+}
+
+/*
+ * Mask of the message types in the frame, 0 if it
+ * isn't a message frame.
+ */
+uint16_t WAN::_getMessageTypes(Data &frame) {
+    if (!_isMessageFrame(frame)) {
+        return 0;
+    }
+
+    uint8_t* data = frame.getData();
+    uint16_t types = 0;
+
+    for (uint8_t pos = 0; pos < frame.getSize(); pos += WAN_MESSAGE_HEADER_SIZE + data[pos + 1]) {
+        types |= 1 << WAN_MESSAGE_HEADER_TYPE(data[pos]);
+    }
+
+    return types;
+}
+
+/*
+ * The downlink flags of any WAN_MESSAGE_TYPE_DOWNLINK
+ * messages in the frame, 0 if there aren't any.
+ */
+uint8_t WAN::_getDownlinkFlags(Data &frame) {
+    if (!(_getMessageTypes(frame) & (1 << WAN_MESSAGE_TYPE_DOWNLINK))) {
+        return 0;
+    }
+
+    uint8_t* data = frame.getData();
+    uint8_t flags = 0;
+
+    for (uint8_t pos = 0; pos < frame.getSize(); pos += WAN_MESSAGE_HEADER_SIZE + data[pos + 1]) {
+        if (WAN_MESSAGE_TYPE_DOWNLINK == WAN_MESSAGE_HEADER_TYPE(data[pos]) && data[pos + 1]) {
+            flags |= data[pos + WAN_MESSAGE_HEADER_SIZE];
+        }
+    }
+
+    return flags;
 }
 
 /*
  * Public
  */
 
-WAN::WAN(Stream &serial) : _xbee(XBee()), 
-                           _zbRx(ZBRxResponse()), 
-                           _zbTxStatus(ZBTxStatusResponse()),
-                           _led(LED(0)),
-                           _dtrPin(0),
-                           _ctsPin(0),
-                           _sleepEnabled(false) {
-    _init(serial);
+WAN::WAN(Transport &transport) : _led(LED(0)),
+                                 _xbee(XBee()),
+                                 _zbRx(ZBRxResponse()), 
+#ifdef XBEE_IO_SAMPLES
+                                 _zbIoSample(ZBRxIoSampleResponse()),
+#endif
+                                 _zbTxStatus(ZBTxStatusResponse()),
+                                 _atResponse(AtCommandResponse()),
+                                 _modemStatus(ModemStatusResponse()),
+#ifdef XBEE_REMOTE_AT
+                                 _remoteAtResponse(RemoteAtCommandResponse()),
+#endif
+                                 _transport(&transport),
+                                 _receiveErrors(0),
+                                 _receiveDropped(0),
+                                 _transportOverflows(0),
+                                 _receiveOversize(0),
+                                 _framesSent(0),
+                                 _framesReceived(0),
+                                 _wakeCount(0),
+                                 _wakeTotal(0UL),
+                                 _wakeMin(0xFFFF),
+                                 _wakeMax(0),
+                                 _asleep(false),
+                                 _waking(false),
+                                 _wokeTime(0UL),
+                                 _awakeMillis(0UL),
+                                 _dtrPin(0),
+                                 _ctsPin(0),
+                                 _sleepEnabled(false),
+                                 _deliveryStatus(WAN_DELIVERY_UNKNOWN),
+                                 _deliveryFrameId(0),
+                                 _deliveryAddress(0UL),
+                                 _associated(false),
+                                 _joinStartTime(0UL),
+                                 _joinTime(0UL),
+                                 _joinCount(0),
+                                 _disassociationCount(0),
+                                 _responseFrameId(0),
+                                 _responseStatus(AT_OK),
+                                 _baudRate(XBEE_BAUD_RATE_DEFAULT),
+                                 _rssiAddress(0UL),
+                                 _rssiFrameId(0),
+                                 _deliveryCallback(NULL),
+                                 _txState(WAN_TX_IDLE),
+                                 _sleepRequested(false),
+                                 _sleepTime(0UL),
+                                 _sleepTimeout(XBEE_SLEEP_TIMEOUT_MILLIS),
+                                 _receiveWindow(0UL),
+                                 _listening(false),
+                                 _awakeAddress(0UL),
+                                 _awakeFrameId(0),
+                                 _stateTypes(0) {
+    _init(transport);
 }
 
-WAN::WAN(Stream &serial, LED &statusLed) : _xbee(XBee()), 
-                                          _zbRx(ZBRxResponse()), 
-                                          _zbTxStatus(ZBTxStatusResponse()),
-                                          _led(statusLed),
-                                          _dtrPin(0),
-                                          _ctsPin(0),
-                                          _sleepEnabled(false) {
-    _init(serial);
+WAN::WAN(Transport &transport, LED &statusLed) : _led(statusLed),
+                                                _xbee(XBee()),
+                                                _zbRx(ZBRxResponse()), 
+#ifdef XBEE_IO_SAMPLES
+                                                _zbIoSample(ZBRxIoSampleResponse()),
+#endif
+                                                _zbTxStatus(ZBTxStatusResponse()),
+                                                _atResponse(AtCommandResponse()),
+                                                _modemStatus(ModemStatusResponse()),
+#ifdef XBEE_REMOTE_AT
+                                                _remoteAtResponse(RemoteAtCommandResponse()),
+#endif
+                                                _transport(&transport),
+                                                _receiveErrors(0),
+                                                _receiveDropped(0),
+                                                _transportOverflows(0),
+                                                _receiveOversize(0),
+                                                _framesSent(0),
+                                                _framesReceived(0),
+                                                _wakeCount(0),
+                                                _wakeTotal(0UL),
+                                                _wakeMin(0xFFFF),
+                                                _wakeMax(0),
+                                                _asleep(false),
+                                                _waking(false),
+                                                _wokeTime(0UL),
+                                                _awakeMillis(0UL),
+                                                _dtrPin(0),
+                                                _ctsPin(0),
+                                                _sleepEnabled(false),
+                                                _deliveryStatus(WAN_DELIVERY_UNKNOWN),
+                                                _deliveryFrameId(0),
+                                                _deliveryAddress(0UL),
+                                                _associated(false),
+                                                _joinStartTime(0UL),
+                                                _joinTime(0UL),
+                                                _joinCount(0),
+                                                _disassociationCount(0),
+                                                _responseFrameId(0),
+                                                _responseStatus(AT_OK),
+                                                _baudRate(XBEE_BAUD_RATE_DEFAULT),
+                                                _rssiAddress(0UL),
+                                                _rssiFrameId(0),
+                                                _deliveryCallback(NULL),
+                                                _txState(WAN_TX_IDLE),
+                                                _sleepRequested(false),
+                                                _sleepTime(0UL),
+                                                _sleepTimeout(XBEE_SLEEP_TIMEOUT_MILLIS),
+                                                _receiveWindow(0UL),
+                                                _listening(false),
+                                                _awakeAddress(0UL),
+                                                _awakeFrameId(0),
+                                                _stateTypes(0) {
+    _init(transport);
 }
 
 WAN::~WAN() {
@@ -45,6 +275,11 @@ void WAN::setup() {
 
 void WAN::check() {
     _led.check();
+
+    _checkPending();
+    _checkCommands();
+    _checkTransmit();
+    _checkSleep();
 }
 
 void WAN::enableSleep(uint8_t dtrPin, uint8_t ctsPin) {
@@ -68,6 +303,18 @@ void WAN::disableSleep() {
     _sleepEnabled = false;
 }
 
+void WAN::setSleepTimeout(uint32_t timeout) {
+    _sleepTimeout = timeout;
+}
+
+bool WAN::isSleepPending() {
+    return _sleepRequested;
+}
+
+void WAN::setReceiveWindow(uint32_t window) {
+    _receiveWindow = window;
+}
+
 void WAN::enableLed() {
     _led.setEnabled(true);
 }
@@ -79,53 +326,286 @@ void WAN::disableLed() {
 // XXX investigate using SLEEP_PIN as INPUT instead, less power?
 // http://www.fiz-ix.com/2012/11/low-power-xbee-sleep-mode-with-arduino-and-pin-hibernation/
 void WAN::_sleep() {
-    if (_sleepEnabled) {
-        // wait a bit first, was sometimes sending bad
-        // data (partial packets?) due to sleeping too
-        // quickly.
-        delay(XBEE_SLEEP_DELAY_MILLIS);
+    if (_sleepEnabled && !_sleepRequested) {
+        // sleeping too quickly was sometimes sending bad data
+        // (partial packets?), so only sleep once it's safe
+        _sleepRequested = true;
+        _sleepTime = millis();
+    }
+
+    _checkSleep();
+}
+
+/*
+ * True once the XBee has nothing left to do: every frame
+ * sent has its TX status, every local command its response,
+ * the receive window after a downlink poll has passed (or
+ * the end of the downlinks was received) and CTS shows the
+ * XBee's serial buffer has been drained.
+ */
+bool WAN::_isSleepSafe() {
+    if (WAN_DELIVERY_PENDING == _deliveryStatus) {
+        return false;
+    }
+
+    for (uint8_t i = 0; i < WAN_COMMANDS_SIZE; i++) {
+        if (_commands[i].frameId && !_commands[i].address) {
+            return false;
+        }
+    }
+
+    // the XBee polls its parent for replies while awake
+    if (_listening && millis() - _sleepTime < _receiveWindow) {
+        return false;
+    }
+
+    for (uint8_t i = 0; i < WAN_PENDING_SIZE; i++) {
+        if (_pending[i].frameId && WAN_PENDING_SENT == _pending[i].state) {
+            return false;
+        }
+    }
+
+    return LOW == digitalRead(_ctsPin);
+}
+
+void WAN::_checkSleep() {
+    // an async transmit in progress needs the XBee awake
+    if (!_sleepRequested || WAN_TX_IDLE != _txState) {
+        return;
+    }
+
+    // never wait longer than the sleep timeout, a lost
+    // TX status shouldn't keep the XBee awake
+    if (_isSleepSafe() || millis() - _sleepTime >= _sleepTimeout) {
+        _setAsleep(true);
+        _sleepRequested = false;
 
-        digitalWrite(_dtrPin, HIGH);
+        // anything not yet received waits for the next poll
+        _listening = false;
+
+        // a sleeping XBee won't answer, and millis() stops while
+        // the MCU sleeps too, so don't leave local commands
+        // holding their slots until the timeout
+        _expireCommands(0UL);
     }
 }
 
 void WAN::_wake() {
-    if (_sleepEnabled) {
-        digitalWrite(_dtrPin, LOW);
+    // still awake if it's waiting to sleep
+    if (_sleepEnabled && !_sleepRequested) {
+        _setAsleep(false);
 
         // empirically, this usually takes ~20ms
         while (LOW != digitalRead(_ctsPin)) {
             // delay until CTS_PIN goes low
             delay(XBEE_WAKE_DELAY_MILLIS);
         }
+
+        _checkAwake();
+    }
+}
+
+/*
+ * Sleep or wake the XBee (DTR), counting the time it's awake.
+ */
+void WAN::_setAsleep(bool asleep) {
+    digitalWrite(_dtrPin, asleep ? HIGH : LOW);
+
+    if (asleep == _asleep) {
+        return;
+    }
+
+    _asleep = asleep;
+
+    if (asleep) {
+        _awakeMillis += millis() - _wokeTime;
+        _waking = false;
+    } else {
+        _wokeTime = millis();
+        _waking = true;
+    }
+}
+
+/*
+ * Once CTS shows the XBee has woken, count how long it took.
+ */
+void WAN::_checkAwake() {
+    if (!_waking) {
+        return;
     }
+
+    _waking = false;
+
+    uint16_t latency = millis() - _wokeTime;
+
+    _wakeCount++;
+    _wakeTotal += latency;
+    _wakeMin = min(_wakeMin, latency);
+    _wakeMax = max(_wakeMax, latency);
 }
 
 bool WAN::receive(Data &data) {
-    receive(data, 0);
+    return receive(data, 0);
 }
 
 bool WAN::receive(Data &data, uint32_t timeout) {
     _wake();
 
-    if (timeout) {
-        _xbee.readPacket(timeout);
+    bool received = _receive(data, timeout);
+
+    _sleep();
+
+    _waitForLed();
+
+    return received;
+}
+
+uint8_t WAN::receiveAll() {
+    _wake();
+
+    uint8_t received = 0;
+    Data data = Data();
+    while (_receive(data, 0)) {
+        received++;
+
+        if (!dispatch(data)) {
+            Serial.println(F("Received data was not handled"));
+        }
+    }
+
+    _sleep();
+
+    _waitForLed();
+
+    return received;
+}
+
+uint8_t WAN::receiveAll(uint32_t timeout) {
+    if (!_xbee.getQueuedPackets()) {
+        _waitForPackets(timeout);
+    }
+
+    return receiveAll();
+}
+
+#ifdef XBEE_IO_SAMPLES
+/*
+ * Convert an IO sample to a WAN_MESSAGE_TYPE_IO_SAMPLE message
+ * frame, so it's dispatched like any other message.
+ */
+void WAN::_getIoSample(Data &data) {
+    uint8_t frame[WAN_MESSAGE_HEADER_SIZE + WAN_IO_SAMPLE_DIGITAL_SIZE + 2 * 8];
+    uint8_t* sample = frame + WAN_MESSAGE_HEADER_SIZE;
+    uint8_t size = WAN_IO_SAMPLE_DIGITAL_SIZE;
+
+    uint16_t digital = 0;
+    for (uint8_t pin = 0; pin < 16; pin++) {
+        if (_zbIoSample.isDigitalEnabled(pin) && _zbIoSample.isDigitalOn(pin)) {
+            digital |= 1 << pin;
+        }
+    }
+
+    sample[0] = _zbIoSample.getDigitalMaskMsb();
+    sample[1] = _zbIoSample.getDigitalMaskLsb();
+    sample[2] = digital >> 8;
+    sample[3] = digital & 0xFF;
+    sample[4] = _zbIoSample.getAnalogMask();
+
+    for (uint8_t pin = 0; pin < 8; pin++) {
+        if (_zbIoSample.isAnalogEnabled(pin)) {
+            uint16_t analog = _zbIoSample.getAnalog(pin);
+            sample[size++] = analog >> 8;
+            sample[size++] = analog & 0xFF;
+        }
+    }
+
+    frame[0] = WAN_MESSAGE_HEADER(WAN_MESSAGE_TYPE_IO_SAMPLE, WAN_MESSAGE_VERSION);
+    frame[1] = size;
+
+    data.set(_zbIoSample.getRemoteAddress64().getLsb(), frame, WAN_MESSAGE_HEADER_SIZE + size);
+}
+#endif
+
+/*
+ * Read what's available into the XBee's packet queue, then
+ * handle queued packets (reading more as the queue empties) until
+ * one with data is found. Anything after it is left for the next
+ * call.
+ */
+bool WAN::_receive(Data &data, uint32_t timeout) {
+    // for sketches which only receive(), and never check()
+    _checkCommands();
+
+    if (timeout && !_xbee.getQueuedPackets()) {
+        _waitForPackets(timeout);
     } else {
-        _xbee.readPacket();
+        _xbee.readPackets();
     }
 
-    bool received = false;
-    if (_xbee.getResponse().isAvailable()) {
-        if (ZB_RX_RESPONSE == _xbee.getResponse().getApiId()) {
-            _xbee.getResponse().getZBRxResponse(_zbRx);
+    _checkReceiveErrors();
+
+    while (_nextPacket()) {
+        if (ZB_RX_RESPONSE == _packet.getApiId()) {
+            _packet.getZBRxResponse(_zbRx);
+
+            _learnAddress(_zbRx.getRemoteAddress64().getLsb(), _zbRx.getRemoteAddress16());
+
+            // DB is the RSSI of the last frame received, a response
+            // to an earlier DB may already be for this frame instead
+            _rssiAddress = _zbRx.getRemoteAddress64().getLsb();
+            _rssiFrameId = 0;
+
+            _framesReceived++;
+
+            // none of the stations send more than DATA_MAX_SIZE, a
+            // truncated frame would end in a partial message, so it's
+            // dropped (and counted) rather than returned
+            if (DATA_MAX_SIZE < _zbRx.getDataLength()) {
+                Serial.print(F("Received data too large, size: "));
+                Serial.println(_zbRx.getDataLength());
+                _receiveOversize++;
+                _led.error();
+                continue;
+            }
 
+            // copy the payload, the queued packet is
+            // overwritten by later reads
             data.set(_zbRx.getRemoteAddress64().getLsb(), _zbRx.getData(), _zbRx.getDataLength());
 
-            received = true;
+            uint8_t downlink = _getDownlinkFlags(data);
+            if (WAN_DOWNLINK_POLL & downlink) {
+                // the sender sleeps, and is awake for held frames
+                _sendDownlinks(data.getAddress());
+            }
+            if (WAN_DOWNLINK_END & downlink) {
+                _listening = false;
+            }
+
+            _requestRssi();
+
+            _led.success();
+
+            return true;
+
+#ifdef XBEE_IO_SAMPLES
+        } else if (ZB_IO_SAMPLE_RESPONSE == _packet.getApiId()) {
+            _packet.getZBRxIoSampleResponse(_zbIoSample);
+
+            _learnAddress(_zbIoSample.getRemoteAddress64().getLsb(), _zbIoSample.getRemoteAddress16());
+
+            _getIoSample(data);
+
+            _framesReceived++;
+
             _led.success();
 
-        } else if (ZB_TX_STATUS_RESPONSE == _xbee.getResponse().getApiId()) {
-            _xbee.getResponse().getZBTxStatusResponse(_zbTxStatus);
+            return true;
+#endif
+
+        } else if (ZB_TX_STATUS_RESPONSE == _packet.getApiId()) {
+            _packet.getZBTxStatusResponse(_zbTxStatus);
+
+            _handleTxStatus();
 
             if (SUCCESS != _zbTxStatus.getDeliveryStatus()) {
                 Serial.println(F("Delivery Failure :("));
@@ -134,19 +614,160 @@ bool WAN::receive(Data &data, uint32_t timeout) {
             } else {
                 _led.success();
             }
+        } else if (ZB_IO_NODE_IDENTIFIER_RESPONSE == _packet.getApiId()) {
+            _handleNodeIdentifier();
+
+        } else if (MODEM_STATUS_RESPONSE == _packet.getApiId()) {
+            _packet.getModemStatusResponse(_modemStatus);
+
+            if (ASSOCIATED == _modemStatus.getStatus() || COORDINATOR_STARTED == _modemStatus.getStatus()) {
+                _setAssociated(true);
+            } else if (DISASSOCIATED == _modemStatus.getStatus()) {
+                _setAssociated(false);
+            }
+        } else if (AT_COMMAND_RESPONSE == _packet.getApiId()) {
+            _packet.getAtCommandResponse(_atResponse);
+
+            if ('N' == _atResponse.getCommand()[0] && 'D' == _atResponse.getCommand()[1]) {
+                _handleNodeDiscovery();
+            } else if ('A' == _atResponse.getCommand()[0] && 'I' == _atResponse.getCommand()[1]) {
+                // AI is 0 once joined
+                if (_atResponse.isOk() && _atResponse.getValueLength()) {
+                    _setAssociated(0 == _atResponse.getValue()[0]);
+                }
+            } else if ('D' == _atResponse.getCommand()[0] && 'B' == _atResponse.getCommand()[1]) {
+                if (_rssiFrameId && _rssiFrameId == _atResponse.getFrameId()) {
+                    if (_atResponse.isOk() && _atResponse.getValueLength()) {
+                        _updateRssi(_rssiAddress, _atResponse.getValue()[0]);
+                    }
+
+                    _rssiAddress = 0UL;
+                    _rssiFrameId = 0;
+                }
+            }
+
+            _handleCommandResponse(_atResponse.getFrameId(),
+                                   0UL,
+                                   _atResponse.getStatus(),
+                                   _atResponse.getValue(),
+                                   _atResponse.getValueLength());
+
+#ifdef XBEE_REMOTE_AT
+        } else if (REMOTE_AT_COMMAND_RESPONSE == _packet.getApiId()) {
+            _packet.getRemoteAtCommandResponse(_remoteAtResponse);
+
+            _handleCommandResponse(_remoteAtResponse.getFrameId(),
+                                   _remoteAtResponse.getRemoteAddress64().getLsb(),
+                                   _remoteAtResponse.getStatus(),
+                                   _remoteAtResponse.getValue(),
+                                   _remoteAtResponse.getValueLength());
+#endif
         } else {
             Serial.print(F("UNEXPECTED RESPONSE: "));
-            Serial.println(_xbee.getResponse().getApiId());
+            Serial.println(_packet.getApiId());
             _led.error();
         }
-    } else if (_xbee.getResponse().isError()) {
-        Serial.print(F("Error reading packet. Error code: "));
-        Serial.println(_xbee.getResponse().getErrorCode());
+    }
+
+    _requestRssi();
+
+    return false;
+}
+
+/*
+ * Ask for the RSSI (DB) of the last frame received, once no other
+ * frame is waiting to be read, so the response can only be for
+ * that frame's sender. It's a command like any other, so the XBee
+ * stays awake for the response, which is matched by frame id.
+ */
+void WAN::_requestRssi() {
+    if (!_rssiAddress || _rssiFrameId || _xbee.getQueuedPackets() || _transport->available()) {
+        return;
+    }
+
+    _rssiFrameId = _queueCommand(0UL, "DB", NULL, 0, NULL);
+    if (!_rssiFrameId) {
+        // no command slot, skip this sample
+        _rssiAddress = 0UL;
+    }
+}
+
+/*
+ * The next queued packet, reading more once the queue is empty
+ * (readPackets() leaves the rest unread while it's full).
+ */
+bool WAN::_nextPacket() {
+    if (!_xbee.getQueuedPackets()) {
+        _xbee.readPackets();
+    }
+
+    return _xbee.nextPacket(_packet);
+}
+
+/*
+ * Read until a packet is queued, idling the MCU while nothing has
+ * been received, rather than polling. Returns false after the
+ * timeout.
+ */
+bool WAN::_waitForPackets(uint32_t timeout) {
+    uint32_t start = millis();
+
+    while (!_xbee.readPackets()) {
+        if (millis() - start >= timeout) {
+            return false;
+        }
+
+        _transport->idle();
+    }
+
+    return true;
+}
+
+void WAN::_checkReceiveErrors() {
+    uint16_t errors = _xbee.getPacketErrorCount();
+    if (errors != _receiveErrors) {
+        Serial.print(F("Error reading packets: "));
+        Serial.println(errors - _receiveErrors);
+        _receiveErrors = errors;
         _led.error();
     }
 
-    _sleep();
+    uint16_t dropped = getReceiveDroppedCount();
+    if (dropped != _receiveDropped) {
+        Serial.print(F("Dropped received packets: "));
+        Serial.println(dropped - _receiveDropped);
+        _receiveDropped = dropped;
+        _led.error();
+    }
+
+    uint16_t overflows = _transport->getOverflowCount();
+    if (overflows != _transportOverflows) {
+        Serial.print(F("Transport dropped bytes: "));
+        Serial.println(overflows - _transportOverflows);
+        _transportOverflows = overflows;
+        _led.error();
+    }
+}
+
+void WAN::_countTxFailure(uint8_t status) {
+    switch (status) {
+        case NETWORK_ACK_FAILURE:
+            _txFailures[WAN_STATS_TX_NETWORK_ACK]++;
+            break;
+        case ADDRESS_NOT_FOUND:
+        case ROUTE_NOT_FOUND:
+            _txFailures[WAN_STATS_TX_NOT_FOUND]++;
+            break;
+        case WAN_DELIVERY_TIMEOUT:
+            _txFailures[WAN_STATS_TX_TIMEOUT]++;
+            break;
+        default:
+            _txFailures[WAN_STATS_TX_OTHER]++;
+            break;
+    }
+}
 
+void WAN::_waitForLed() {
     // wait for flashing if LED is enabled
     if (_led.enabled()) {
         while(!_led.completedFlashing()) {
@@ -154,47 +775,1336 @@ bool WAN::receive(Data &data, uint32_t timeout) {
             delay(100);
         }
     }
+}
 
-    return received;
+uint16_t WAN::getReceiveOverflowCount() {
+    return _xbee.getQueueOverflowCount();
 }
 
-bool WAN::transmit(Data *data) {
-    XBeeAddress64 addr64 = XBeeAddress64(XBEE_FAMILY_ADDRESS, data->getAddress());
-    ZBTxRequest zbTx = ZBTxRequest(addr64, data->getData(), data->getSize());
-    
-    _wake();
+uint16_t WAN::getTransportOverflowCount() {
+    return _transport->getOverflowCount();
+}
 
-    _xbee.send(zbTx);
+void WAN::getStats(WANStats &stats) {
+    stats.sent = _framesSent;
+    stats.received = _framesReceived;
 
-    _sleep();
+    for (uint8_t i = 0; i < WAN_STATS_TX_FAILURES; i++) {
+        stats.txFailures[i] = _txFailures[i];
+    }
 
-    // fire, but don't forget - the next receive() call will handle the txResponse
-    // and log it..
+    stats.checksumErrors = _xbee.getChecksumErrorCount();
+    stats.startByteErrors = _xbee.getStartByteErrorCount();
+    stats.receiveDropped = getReceiveDroppedCount();
+    stats.transportOverflows = _transport->getOverflowCount();
+
+    stats.wakeMin = _wakeCount ? _wakeMin : 0;
+    stats.wakeAvg = _wakeCount ? _wakeTotal / _wakeCount : 0;
+    stats.wakeMax = _wakeMax;
+
+    // including the current wake
+    stats.awakeMillis = _awakeMillis;
+    if (!_asleep) {
+        stats.awakeMillis += millis() - _wokeTime;
+    }
+}
+
+bool WAN::addStats(Data &frame) {
+    WANStats stats;
+    getStats(stats);
+
+    uint8_t payload[WAN_STATS_SIZE];
+    uint8_t pos = 0;
+
+    putStat(payload, pos, stats.sent, 2);
+    putStat(payload, pos, stats.received, 2);
+    for (uint8_t i = 0; i < WAN_STATS_TX_FAILURES; i++) {
+        putStat(payload, pos, stats.txFailures[i], 2);
+    }
+    putStat(payload, pos, stats.checksumErrors, 2);
+    putStat(payload, pos, stats.startByteErrors, 2);
+    putStat(payload, pos, stats.receiveDropped, 2);
+    putStat(payload, pos, stats.transportOverflows, 2);
+    putStat(payload, pos, stats.wakeMin, 2);
+    putStat(payload, pos, stats.wakeAvg, 2);
+    putStat(payload, pos, stats.wakeMax, 2);
+    putStat(payload, pos, stats.awakeMillis, 4);
+
+    return addMessage(frame, WAN_MESSAGE_TYPE_STATS, payload, pos);
+}
+
+bool WAN::readStats(Data &message, WANStats &stats) {
+    if (message.getSize() < WAN_STATS_SIZE) {
+        return false;
+    }
+
+    uint8_t* payload = message.getData();
+    uint8_t pos = 0;
+
+    stats.sent = getStat(payload, pos, 2);
+    stats.received = getStat(payload, pos, 2);
+    for (uint8_t i = 0; i < WAN_STATS_TX_FAILURES; i++) {
+        stats.txFailures[i] = getStat(payload, pos, 2);
+    }
+    stats.checksumErrors = getStat(payload, pos, 2);
+    stats.startByteErrors = getStat(payload, pos, 2);
+    stats.receiveDropped = getStat(payload, pos, 2);
+    stats.transportOverflows = getStat(payload, pos, 2);
+    stats.wakeMin = getStat(payload, pos, 2);
+    stats.wakeAvg = getStat(payload, pos, 2);
+    stats.wakeMax = getStat(payload, pos, 2);
+    stats.awakeMillis = getStat(payload, pos, 4);
 
-    // TODO how to confirm success???
     return true;
 }
 
+uint16_t WAN::getReceiveDroppedCount() {
+    return _xbee.getQueueOverflowCount() + _xbee.getQueueOversizeCount() + _receiveOversize;
+}
+
+/*
+ * Hash the address to its first slot, and probe from there until
+ * the address or a free slot is found. Nodes are never removed, so
+ * a free slot ends the search.
+ */
+WANNode* WAN::_findNode(uint32_t address) {
+    uint8_t hash = (address ^ (address >> 8) ^ (address >> 16) ^ (address >> 24)) & (WAN_NODES_SIZE - 1);
+
+    for (uint8_t i = 0; i < WAN_NODES_SIZE; i++) {
+        WANNode &node = _nodes[(hash + i) & (WAN_NODES_SIZE - 1)];
+        if (!node.address || address == node.address) {
+            return &node;
+        }
+    }
+
+    return NULL;
+}
+
+/*
+ * A role and instance is only at one address, the last registered,
+ * so a discovered node takes it from the address it was seeded at.
+ * The old entry is kept (nodes are never removed) with an unknown
+ * role.
+ */
+void WAN::_registerNode(uint32_t address, uint8_t role, uint8_t instance) {
+    WANNode* node = address ? _findNode(address) : NULL;
+    if (!node) {
+        Serial.println(F("Too many nodes"));
+        return;
+    }
+
+    for (uint8_t i = 0; i < WAN_NODES_SIZE && WAN_ROLE_UNKNOWN != role; i++) {
+        WANNode &other = _nodes[i];
+        if (other.address && address != other.address && role == other.role && instance == other.instance) {
+            other.role = WAN_ROLE_UNKNOWN;
+            other.instance = 0;
+        }
+    }
+
+    if (!node->address) {
+        node->rssi = 0;
+        node->rssiAge = 0;
+        node->retries = 0;
+    }
+
+    node->address = address;
+    node->role = role;
+    node->instance = instance;
+}
+
+/*
+ * The node, registered with an unknown role if it's new.
+ */
+WANNode* WAN::_getNode(uint32_t address) {
+    if (!address) {
+        return NULL;
+    }
+
+    WANNode* node = _findNode(address);
+    if (node && !node->address) {
+        node->address = address;
+        node->role = WAN_ROLE_UNKNOWN;
+        node->instance = 0;
+        node->rssi = 0;
+        node->rssiAge = 0;
+        node->retries = 0;
+    }
+
+    return node;
+}
+
+void WAN::_updateRssi(uint32_t address, uint8_t rssi) {
+    WANNode* node = _getNode(address);
+    if (!node) {
+        return;
+    }
+
+    // start from the first sample, or over if it's stale
+    if (!node->rssi || node->rssiAge > WAN_LINK_RSSI_MAX_AGE) {
+        node->rssi = rssi << 4;
+    } else {
+        node->rssi += ((int16_t)(rssi << 4) - (int16_t)node->rssi) >> WAN_LINK_EWMA_SHIFT;
+    }
+
+    node->rssiAge = 0;
+}
+
+void WAN::_updateRetries(uint32_t address, uint8_t retries) {
+    WANNode* node = _getNode(address);
+    if (!node) {
+        return;
+    }
+
+    node->retries += ((int16_t)(retries << 4) - (int16_t)node->retries) >> WAN_LINK_EWMA_SHIFT;
+
+    if (node->rssiAge < 0xFF) {
+        node->rssiAge++;
+    }
+}
+
+/*
+ * Register a node by its node identifier (NI) string, which
+ * isn't null terminated.
+ */
+void WAN::_registerNode(uint32_t address, uint8_t* nodeId, uint8_t length) {
+    const char* id = (const char*)nodeId;
+    uint8_t role = WAN_ROLE_UNKNOWN;
+    uint8_t pos = 0;
+
+    if (length >= sizeof(WAN_NODE_ID_BASE_STATION) - 1 &&
+            !strncmp_P(id, PSTR(WAN_NODE_ID_BASE_STATION), sizeof(WAN_NODE_ID_BASE_STATION) - 1)) {
+        role = WAN_ROLE_BASE_STATION;
+        pos = sizeof(WAN_NODE_ID_BASE_STATION) - 1;
+    } else if (length >= sizeof(WAN_NODE_ID_REMOTE_SENSOR) - 1 &&
+            !strncmp_P(id, PSTR(WAN_NODE_ID_REMOTE_SENSOR), sizeof(WAN_NODE_ID_REMOTE_SENSOR) - 1)) {
+        role = WAN_ROLE_REMOTE_SENSOR;
+        pos = sizeof(WAN_NODE_ID_REMOTE_SENSOR) - 1;
+    } else if (length >= sizeof(WAN_NODE_ID_PUMP_SWITCH) - 1 &&
+            !strncmp_P(id, PSTR(WAN_NODE_ID_PUMP_SWITCH), sizeof(WAN_NODE_ID_PUMP_SWITCH) - 1)) {
+        role = WAN_ROLE_PUMP_SWITCH;
+        pos = sizeof(WAN_NODE_ID_PUMP_SWITCH) - 1;
+    }
+
+    uint8_t instance = 0;
+    while (pos < length && isdigit(id[pos])) {
+        instance = instance * 10 + (id[pos] - '0');
+        pos++;
+    }
+
+    Serial.print(F("Node "));
+    Serial.print(address, HEX);
+    Serial.print(F(" role: "));
+    Serial.print(role);
+    Serial.print(F(" instance: "));
+    Serial.println(instance);
+
+    _registerNode(address, role, instance);
+}
+
+/*
+ * Joins and leaves, from modem statuses and AI (association) responses.
+ */
+void WAN::_setAssociated(bool associated) {
+    if (associated == _associated) {
+        return;
+    }
+
+    _associated = associated;
+
+    if (associated) {
+        _joinTime = millis() - _joinStartTime;
+        _joinCount++;
+
+        Serial.print(F("XBee joined the network, join time (ms): "));
+        Serial.println(_joinTime);
+    } else {
+        _joinStartTime = millis();
+        _disassociationCount++;
+
+        Serial.println(F("XBee left the network"));
+    }
+}
+
+uint8_t WAN::_sendCommand(uint32_t address, const char* command, uint8_t* value, uint8_t length) {
+    uint8_t frameId = _xbee.getNextFrameId();
+
+    _sendCommand(frameId, address, command, value, length);
+
+    return frameId;
+}
+
+void WAN::_sendCommand(uint8_t frameId, uint32_t address, const char* command, uint8_t* value, uint8_t length) {
+    _wake();
+
+    if (address) {
+#ifdef XBEE_REMOTE_AT
+        XBeeAddress64 addr64 = XBeeAddress64(XBEE_FAMILY_ADDRESS, address);
+        RemoteAtCommandRequest request = RemoteAtCommandRequest(addr64, (uint8_t*)command, value, length);
+        request.setFrameId(frameId);
+
+        _xbee.send(request);
+#else
+        Serial.println(F("Remote AT commands not compiled in"));
+#endif
+    } else {
+        AtCommandRequest request = AtCommandRequest((uint8_t*)command, value, length);
+        request.setFrameId(frameId);
+
+        _xbee.send(request);
+    }
+
+    _sleep();
+}
+
+uint8_t WAN::_queueCommand(uint32_t address, const char* command, uint8_t* value, uint8_t length, WANCommandCallback callback) {
+    WANCommand* slot = NULL;
+    for (uint8_t i = 0; i < WAN_COMMANDS_SIZE; i++) {
+        if (!_commands[i].frameId) {
+            slot = &_commands[i];
+            break;
+        }
+    }
+
+    if (!slot) {
+        Serial.println(F("Too many pending commands"));
+        return 0;
+    }
+
+    // taken before sending, the XBee isn't slept while it's pending
+    slot->frameId = _xbee.getNextFrameId();
+    slot->address = address;
+    slot->time = millis();
+    slot->callback = callback;
+    slot->verify = false;
+    slot->command[0] = command[0];
+    slot->command[1] = command[1];
+
+    uint8_t frameId = slot->frameId;
+    _sendCommand(frameId, address, command, value, length);
+
+    return frameId;
+}
+
+void WAN::_handleCommandResponse(uint8_t frameId, uint32_t address, uint8_t status, uint8_t* value, uint8_t length) {
+    WANCommand* command = NULL;
+    for (uint8_t i = 0; i < WAN_COMMANDS_SIZE; i++) {
+        if (frameId && frameId == _commands[i].frameId) {
+            command = &_commands[i];
+            break;
+        }
+    }
+
+    if (!command) {
+        return;
+    }
+
+    // free the slot first, the callback may send another command
+    command->frameId = 0;
+
+    _responseFrameId = frameId;
+    _responseStatus = status;
+
+    if (command->verify) {
+        uint16_t actual = 0;
+        for (uint8_t i = 0; i < length; i++) {
+            actual = (actual << 8) + value[i];
+        }
+
+        Serial.print(F("Setting "));
+        Serial.print(command->command[0]);
+        Serial.print(command->command[1]);
+
+        if (AT_OK != status) {
+            Serial.print(F(" not read, status: "));
+            Serial.println(status);
+        } else if (actual != command->expected) {
+            Serial.print(F(" is "));
+            Serial.print(actual, HEX);
+            Serial.print(F(", setting it to "));
+            Serial.println(command->expected, HEX);
+
+            uint8_t expected[] = { (uint8_t) (command->expected >> 8), (uint8_t) command->expected };
+            uint8_t size = command->expected > 0xFF ? 2 : 1;
+            char setting[] = { command->command[0], command->command[1] };
+
+            _sendCommand(command->address, setting, expected + 2 - size, size);
+            _sendCommand(command->address, "WR", NULL, 0);
+        } else {
+            Serial.println(F(" verified"));
+        }
+    }
+
+    if (command->callback) {
+        (*command->callback)(frameId, address, status, value, length);
+    }
+}
+
+void WAN::_checkCommands() {
+    for (uint8_t i = 0; i < WAN_COMMANDS_SIZE; i++) {
+        WANCommand &command = _commands[i];
+        if (command.frameId && millis() - command.time > WAN_COMMAND_TIMEOUT_MILLIS) {
+            _handleCommandResponse(command.frameId, command.address, AT_NO_RESPONSE, NULL, 0);
+        }
+    }
+}
+
+void WAN::_expireCommands(uint32_t address) {
+    for (uint8_t i = 0; i < WAN_COMMANDS_SIZE; i++) {
+        WANCommand &command = _commands[i];
+        if (command.frameId && address == command.address) {
+            _handleCommandResponse(command.frameId, command.address, AT_NO_RESPONSE, NULL, 0);
+        }
+    }
+}
+
+/*
+ * Send a local command and wait for its response, handling anything
+ * else received meanwhile. Returns the response status, or
+ * AT_NO_RESPONSE after the timeout.
+ */
+uint8_t WAN::_waitForCommand(const char* command, uint8_t* value, uint8_t length, uint32_t timeout) {
+    uint8_t frameId = _queueCommand(0UL, command, value, length, NULL);
+    if (!frameId) {
+        return AT_NO_RESPONSE;
+    }
+
+    uint32_t start = millis();
+
+    Data data = Data();
+    while (_responseFrameId != frameId) {
+        uint32_t elapsed = millis() - start;
+        if (elapsed >= timeout) {
+            // give up now, rather than after WAN_COMMAND_TIMEOUT_MILLIS
+            _handleCommandResponse(frameId, 0UL, AT_NO_RESPONSE, NULL, 0);
+            break;
+        }
+
+        if (receive(data, timeout - elapsed) && !dispatch(data)) {
+            Serial.println(F("Received data was not handled"));
+        }
+    }
+
+    return _responseStatus;
+}
+
+uint32_t WAN::_getBaudRate(uint8_t code) {
+    return pgm_read_dword(&XBEE_BAUD_RATE_TABLE[code]);
+}
+
+/*
+ * The BD value for baud, XBEE_BAUD_RATES if it isn't supported.
+ */
+uint8_t WAN::_getBaudRateCode(uint32_t baud) {
+    uint8_t code = 0;
+    while (code < XBEE_BAUD_RATES && _getBaudRate(code) != baud) {
+        code++;
+    }
+
+    return code;
+}
+
+/*
+ * Long enough for a command and its response at baud (10 bits
+ * a byte), ~70ms at 9600 and ~220ms at 1200.
+ */
+uint32_t WAN::_getProbeTimeout(uint32_t baud) {
+    return WAN_BAUD_PROBE_TIMEOUT_MILLIS + WAN_BAUD_PROBE_BYTES * 10 * 1000UL / baud;
+}
+
+void WAN::_setBaudRate(uint32_t baud) {
+    _transport->begin(baud);
+    _baudRate = baud;
+}
+
+/*
+ * Switch the transport to baud, true if the XBee answers at it.
+ */
+bool WAN::_probeBaudRate(uint32_t baud) {
+    _setBaudRate(baud);
+
+    return AT_OK == _waitForCommand("BD", NULL, 0, _getProbeTimeout(baud));
+}
+
+/*
+ * Probe baud, then the factory default, then the rest (fastest
+ * first), staying at the first rate the XBee answers at. False,
+ * at the default, if it doesn't answer at any.
+ */
+bool WAN::_findBaudRate(uint32_t baud) {
+    if (_probeBaudRate(baud)) {
+        return true;
+    }
+
+    if (XBEE_BAUD_RATE_DEFAULT != baud && _probeBaudRate(XBEE_BAUD_RATE_DEFAULT)) {
+        return true;
+    }
+
+    for (uint8_t i = XBEE_BAUD_RATES; i > 0; i--) {
+        uint32_t rate = _getBaudRate(i - 1);
+        if (rate != baud && rate != XBEE_BAUD_RATE_DEFAULT && _probeBaudRate(rate)) {
+            return true;
+        }
+    }
+
+    Serial.println(F("XBee not found at any baud rate"));
+    _setBaudRate(XBEE_BAUD_RATE_DEFAULT);
+
+    return false;
+}
+
+/*
+ * Node identification indicator (0x95), sent when a node joins:
+ *   [SRC64 (8)][SRC16 (2)][OPTIONS][REMOTE16 (2)][REMOTE64 (8)][NI...][0]...
+ */
+void WAN::_handleNodeIdentifier() {
+    uint8_t* frame = _packet.getFrameData();
+    uint8_t length = _packet.getFrameDataLength();
+    if (length < 21) {
+        return;
+    }
+
+    uint32_t address = ((uint32_t)frame[17] << 24) + ((uint32_t)frame[18] << 16) + ((uint16_t)frame[19] << 8) + frame[20];
+    uint8_t* nodeId = frame + 21;
+
+    _registerNode(address, nodeId, strnlen((const char*)nodeId, length - 21));
+    _learnAddress(address, (frame[11] << 8) + frame[12]);
+}
+
+/*
+ * Each ND response value holds one node:
+ *   [MY (2)][SH (4)][SL (4)][NI...][0]...
+ */
+void WAN::_handleNodeDiscovery() {
+    uint8_t* value = _atResponse.getValue();
+    uint8_t length = _atResponse.getValueLength();
+    if (!_atResponse.isOk() || length < 10) {
+        return;
+    }
+
+    uint32_t address = ((uint32_t)value[6] << 24) + ((uint32_t)value[7] << 16) + ((uint16_t)value[8] << 8) + value[9];
+    uint8_t* nodeId = value + 10;
+
+    _registerNode(address, nodeId, strnlen((const char*)nodeId, length - 10));
+    _learnAddress(address, (value[0] << 8) + value[1]);
+}
+
+/*
+ * The cached 16-bit address, or ZB_BROADCAST_ADDRESS (0xFFFE)
+ * which has the XBee discover it.
+ */
+uint16_t WAN::_getAddress16(uint32_t address) {
+    for (uint8_t i = 0; i < WAN_ADDRESS_CACHE_SIZE; i++) {
+        if (address && address == _addresses[i].address) {
+            return _addresses[i].address16;
+        }
+    }
+
+    return ZB_BROADCAST_ADDRESS;
+}
+
+void WAN::_learnAddress(uint32_t address, uint16_t address16) {
+    if (!address || ZB_BROADCAST_ADDRESS == address16) {
+        return;
+    }
+
+    for (uint8_t i = 0; i < WAN_ADDRESS_CACHE_SIZE; i++) {
+        if (address == _addresses[i].address) {
+            _addresses[i].address16 = address16;
+            return;
+        }
+    }
+
+    // replace the oldest entry
+    _addresses[_nextAddress].address = address;
+    _addresses[_nextAddress].address16 = address16;
+    _nextAddress = (_nextAddress + 1) % WAN_ADDRESS_CACHE_SIZE;
+}
+
+void WAN::_forgetAddress(uint32_t address) {
+    for (uint8_t i = 0; i < WAN_ADDRESS_CACHE_SIZE; i++) {
+        if (address == _addresses[i].address) {
+            _addresses[i].address = 0UL;
+        }
+    }
+}
+
+const WANTxHeader* WAN::_findTxHeader(uint32_t address) {
+    for (uint8_t i = 0; i < sizeof(WAN_TX_HEADERS) / sizeof(WAN_TX_HEADERS[0]); i++) {
+        if (address == pgm_read_dword(&WAN_TX_HEADERS[i].address)) {
+            return &WAN_TX_HEADERS[i];
+        }
+    }
+
+    return NULL;
+}
+
+void WAN::_sendFrame(Data *data, uint8_t frameId) {
+    const WANTxHeader* header = _findTxHeader(data->getAddress());
+    if (header) {
+        // fixed nodes skip building the request, and summing the address
+        _xbee.sendZBTx_P(frameId,
+                         header->addr64,
+                         pgm_read_byte(&header->checksum),
+                         _getAddress16(data->getAddress()),
+                         ZB_BROADCAST_RADIUS_MAX_HOPS,
+                         ZB_TX_UNICAST,
+                         data->getData(),
+                         data->getSize());
+    } else {
+        XBeeAddress64 addr64 = XBeeAddress64(XBEE_FAMILY_ADDRESS, data->getAddress());
+        ZBTxRequest zbTx = ZBTxRequest(addr64, 
+                                       _getAddress16(data->getAddress()), 
+                                       ZB_BROADCAST_RADIUS_MAX_HOPS, 
+                                       ZB_TX_UNICAST, 
+                                       data->getData(), 
+                                       data->getSize(), 
+                                       frameId);
+
+        _xbee.send(zbTx);
+    }
+
+    // the sleep timeout restarts with each transmit
+    _sleepTime = millis();
+
+    if (WAN_DOWNLINK_POLL & _getDownlinkFlags(*data)) {
+        _listening = true;
+    }
+
+    _framesSent++;
+}
+
+void WAN::_send(Data *data, uint8_t frameId) {
+    _wake();
+
+    _sendFrame(data, frameId);
+
+    _sleep();
+}
+
+WANPending* WAN::_findPending(uint8_t frameId) {
+    for (uint8_t i = 0; i < WAN_PENDING_SIZE; i++) {
+        if (frameId && frameId == _pending[i].frameId) {
+            return &_pending[i];
+        }
+    }
+
+    return NULL;
+}
+
+/*
+ * The next transmit to send, the highest priority
+ * and then the longest queued.
+ */
+WANPending* WAN::_findQueued() {
+    WANPending* next = NULL;
+    for (uint8_t i = 0; i < WAN_PENDING_SIZE; i++) {
+        WANPending &pending = _pending[i];
+        if (!pending.frameId || WAN_PENDING_QUEUED != pending.state) {
+            continue;
+        }
+
+        if (!next || pending.priority > next->priority ||
+                (pending.priority == next->priority && (int32_t)(pending.time - next->time) < 0)) {
+            next = &pending;
+        }
+    }
+
+    return next;
+}
+
+/*
+ * A free slot, or else a completed slot whose
+ * status was never checked.
+ */
+WANPending* WAN::_findFree() {
+    WANPending* slot = NULL;
+    for (uint8_t i = 0; i < WAN_PENDING_SIZE; i++) {
+        WANPending &pending = _pending[i];
+        if (!pending.frameId) {
+            return &pending;
+        }
+
+        if (!slot && WAN_PENDING_DONE == pending.state) {
+            slot = &pending;
+        }
+    }
+
+    return slot;
+}
+
+/*
+ * The lowest priority transmit below priority which
+ * hasn't been sent yet (or is waiting to be retried).
+ */
+WANPending* WAN::_findLowerPriority(uint8_t priority) {
+    WANPending* lowest = NULL;
+    for (uint8_t i = 0; i < WAN_PENDING_SIZE; i++) {
+        WANPending &pending = _pending[i];
+        if (!pending.frameId || pending.priority >= priority ||
+                (WAN_PENDING_QUEUED != pending.state && WAN_PENDING_RETRY != pending.state)) {
+            continue;
+        }
+
+        if (!lowest || pending.priority < lowest->priority) {
+            lowest = &pending;
+        }
+    }
+
+    return lowest;
+}
+
+/*
+ * A transmit to the same node not sent yet (or waiting to be
+ * retried), whose messages are all state messages repeated
+ * in data.
+ */
+WANPending* WAN::_findSuperseded(Data *data) {
+    uint16_t types = _getMessageTypes(*data);
+    if (!types) {
+        return NULL;
+    }
+
+    for (uint8_t i = 0; i < WAN_PENDING_SIZE; i++) {
+        WANPending &pending = _pending[i];
+        if (!pending.frameId || pending.data.getAddress() != data->getAddress() ||
+                (WAN_PENDING_QUEUED != pending.state && WAN_PENDING_RETRY != pending.state)) {
+            continue;
+        }
+
+        uint16_t queued = _getMessageTypes(pending.data);
+        if (queued && !(queued & ~_stateTypes) && !(queued & ~types)) {
+            return &pending;
+        }
+    }
+
+    return NULL;
+}
+
+uint8_t WAN::_queue(Data *data, uint8_t maxAttempts, uint8_t priority) {
+    WANPending* slot = _findSuperseded(data);
+    if (slot) {
+        // only the latest state is sent, as soon as the
+        // transmit it replaces would have been
+        slot->data.set(data->getAddress(), data->getData(), data->getSize());
+        slot->attempts = 0;
+        slot->maxAttempts = max(slot->maxAttempts, maxAttempts);
+        slot->priority = max(slot->priority, priority);
+
+        Serial.print(F("Coalesced transmit, frame: "));
+        Serial.println(slot->frameId);
+
+        return slot->frameId;
+    }
+
+    slot = _findFree();
+    if (!slot) {
+        WANPending* lower = _findLowerPriority(priority);
+        if (lower) {
+            // the callback may queue another transmit, find
+            // the free slot again afterwards
+            _completePending(*lower, WAN_DELIVERY_DROPPED);
+            slot = _findFree();
+        }
+    }
+
+    if (!slot) {
+        Serial.println(F("Too many pending transmits"));
+        return 0;
+    }
+
+    // keep a copy, the caller's data may be gone before it's sent
+    slot->data.set(data->getAddress(), data->getData(), data->getSize());
+    slot->frameId = _xbee.getNextFrameId();
+    slot->status = WAN_DELIVERY_PENDING;
+    slot->state = WAN_PENDING_QUEUED;
+    slot->attempts = 0;
+    slot->maxAttempts = maxAttempts;
+    slot->priority = priority;
+    slot->time = millis();
+
+    return slot->frameId;
+}
+
+void WAN::_completePending(WANPending &pending, uint8_t status) {
+    pending.status = status;
+    pending.state = WAN_PENDING_DONE;
+
+    if (SUCCESS != status) {
+        Serial.print(F("Transmit failed, frame: "));
+        Serial.print(pending.frameId);
+        Serial.print(F(" status: "));
+        Serial.println(status);
+    }
+
+    if (_deliveryCallback) {
+        (*_deliveryCallback)(pending.frameId, pending.data.getAddress(), status);
+    }
+}
+
+/*
+ * Retry after a failed attempt, backing off exponentially,
+ * until the maximum attempts have been made.
+ */
+void WAN::_failPending(WANPending &pending, uint8_t status) {
+    if (pending.maxAttempts <= pending.attempts) {
+        _completePending(pending, status);
+        return;
+    }
+
+    pending.state = WAN_PENDING_RETRY;
+    pending.time = millis() + (WAN_RETRY_BACKOFF_MILLIS << (pending.attempts - 1));
+}
+
+void WAN::_checkPending() {
+    for (uint8_t i = 0; i < WAN_PENDING_SIZE; i++) {
+        WANPending &pending = _pending[i];
+        if (!pending.frameId) {
+            continue;
+        }
+
+        if (WAN_PENDING_RETRY == pending.state) {
+            if ((int32_t)(millis() - pending.time) >= 0) {
+                Serial.print(F("Retrying transmit, frame: "));
+                Serial.println(pending.frameId);
+                pending.state = WAN_PENDING_QUEUED;
+            }
+        } else if (WAN_PENDING_SENT == pending.state) {
+            if (millis() - pending.time > WAN_TX_STATUS_TIMEOUT_MILLIS) {
+                _countTxFailure(WAN_DELIVERY_TIMEOUT);
+                _failPending(pending, WAN_DELIVERY_TIMEOUT);
+            }
+        }
+    }
+}
+
+/*
+ * Step the queued transmits through waking the XBee and
+ * sending without blocking, the XBee sleeps once they're done.
+ */
+void WAN::_checkTransmit() {
+    switch (_txState) {
+        case WAN_TX_IDLE:
+            if (!_findQueued()) {
+                return;
+            }
+
+            if (_sleepEnabled && !_sleepRequested) {
+                _setAsleep(false);
+            }
+
+            _txState = WAN_TX_WAKING;
+
+            // the XBee may already be awake
+            // fall through
+        case WAN_TX_WAKING:
+            if (_sleepEnabled && LOW != digitalRead(_ctsPin)) {
+                // CTS goes low once the XBee is awake
+                return;
+            }
+
+            _checkAwake();
+
+            WANPending* pending;
+            while ((pending = _findQueued())) {
+                pending->attempts++;
+                pending->state = WAN_PENDING_SENT;
+                pending->time = millis();
+
+                _sendFrame(&pending->data, pending->frameId);
+            }
+
+            _txState = WAN_TX_IDLE;
+
+            // sleeps once the TX statuses are received
+            _sleep();
+
+            break;
+    }
+}
+
+void WAN::_handleTxStatus() {
+    uint8_t frameId = _zbTxStatus.getFrameId();
+    uint8_t status = _zbTxStatus.getDeliveryStatus();
+
+    WANPending* pending = _findPending(frameId);
+
+    uint32_t address = 0UL;
+    if (frameId == _deliveryFrameId) {
+        _deliveryStatus = status;
+        address = _deliveryAddress;
+    } else if (pending) {
+        address = pending->data.getAddress();
+    }
+
+    // the node may have a new 16-bit address (e.g. after rejoining),
+    // have the next transmit discover it again
+    if (SUCCESS == status) {
+        _learnAddress(address, _zbTxStatus.getRemoteAddress());
+    } else {
+        _forgetAddress(address);
+        _countTxFailure(status);
+    }
+
+    _updateRetries(address, _zbTxStatus.getTxRetryCount());
+
+    if (!pending || WAN_PENDING_SENT != pending->state) {
+        return;
+    }
+
+    if (SUCCESS == status) {
+        _completePending(*pending, status);
+    } else {
+        _failPending(*pending, status);
+    }
+}
+
+bool WAN::transmit(Data *data) {
+    _deliveryStatus = WAN_DELIVERY_PENDING;
+    _deliveryFrameId = _xbee.getNextFrameId();
+    _deliveryAddress = data->getAddress();
+
+    _send(data, _deliveryFrameId);
+
+    // fire, but don't forget - the next receive() call will handle the txResponse
+    // and log it, see getDeliveryStatus() or transmitReliable().
+    return true;
+}
+
+uint8_t WAN::transmitAsync(Data *data) {
+    return _queue(data, 1, WAN_PRIORITY_NORMAL);
+}
+
+uint8_t WAN::transmitReliable(Data *data) {
+    return _queue(data, WAN_RETRY_MAX_ATTEMPTS, WAN_PRIORITY_NORMAL);
+}
+
+uint8_t WAN::transmitAsync(Data *data, uint8_t priority) {
+    return _queue(data, 1, priority);
+}
+
+uint8_t WAN::transmitReliable(Data *data, uint8_t priority) {
+    return _queue(data, WAN_RETRY_MAX_ATTEMPTS, priority);
+}
+
+/*
+ * Hold the frame until its node is next heard from, replacing
+ * an identical frame already held for it.
+ */
+bool WAN::transmitDownlink(Data *data) {
+    // queued ahead of the end, if it hasn't been sent yet
+    WANPending* end = _findPending(_awakeFrameId);
+    if (end && WAN_PENDING_QUEUED == end->state && data->getAddress() == _awakeAddress) {
+        return transmitAsync(data);
+    }
+
+    WANDownlink* slot = NULL;
+    for (uint8_t i = 0; i < WAN_DOWNLINK_SIZE; i++) {
+        WANDownlink &downlink = _downlinks[i];
+        if (!downlink.held) {
+            if (!slot) {
+                slot = &downlink;
+            }
+        } else if (downlink.data.getAddress() == data->getAddress() &&
+                   downlink.data.getSize() == data->getSize() &&
+                   !memcmp(downlink.data.getData(), data->getData(), data->getSize())) {
+            return true;
+        }
+    }
+
+    if (!slot) {
+        Serial.println(F("Too many downlink frames"));
+        return false;
+    }
+
+    slot->data.set(data->getAddress(), data->getData(), data->getSize());
+    slot->held = true;
+
+    return true;
+}
+
+/*
+ * Send the frames held for a node which just polled, then
+ * the end of them, at low priority so it's sent after them
+ * (and any queued by the handlers for the poll's frame).
+ */
+void WAN::_sendDownlinks(uint32_t address) {
+    for (uint8_t i = 0; i < WAN_DOWNLINK_SIZE; i++) {
+        WANDownlink &downlink = _downlinks[i];
+        if (downlink.held && address == downlink.data.getAddress()) {
+            // left held if the pending transmits are full,
+            // it's sent the next time instead
+            if (transmitAsync(&downlink.data)) {
+                downlink.held = false;
+            }
+        }
+    }
+
+    uint8_t flags = WAN_DOWNLINK_END;
+    Data end = Data();
+    end.setAddress(address);
+    addMessage(end, WAN_MESSAGE_TYPE_DOWNLINK, &flags, sizeof(flags));
+
+    _awakeAddress = address;
+    _awakeFrameId = transmitAsync(&end, WAN_PRIORITY_LOW);
+}
+
+bool WAN::addDownlinkPoll(Data &frame) {
+    uint8_t flags = WAN_DOWNLINK_POLL;
+    return addMessage(frame, WAN_MESSAGE_TYPE_DOWNLINK, &flags, sizeof(flags));
+}
+
+bool WAN::isTransmitting() {
+    return WAN_TX_IDLE != _txState || _findQueued();
+}
+
+uint8_t WAN::getDeliveryStatus(uint8_t frameId) {
+    WANPending* pending = _findPending(frameId);
+    if (!pending) {
+        return WAN_DELIVERY_UNKNOWN;
+    }
+
+    uint8_t status = pending->status;
+    if (WAN_PENDING_DONE == pending->state) {
+        // completed, free the slot
+        pending->frameId = 0;
+    }
+
+    return status;
+}
+
+void WAN::setDeliveryCallback(WANDeliveryCallback callback) {
+    _deliveryCallback = callback;
+}
+
+uint8_t WAN::getDeliveryStatus() {
+    return _deliveryStatus;
+}
+
+bool WAN::isDelivered() {
+    return SUCCESS == _deliveryStatus;
+}
+
+bool WAN::addMessage(Data &frame, uint8_t type, uint8_t* payload, uint8_t size) {
+    if (frame.getCapacity() - frame.getSize() < WAN_MESSAGE_HEADER_SIZE + size) {
+        Serial.print(F("No room in frame for message type: "));
+        Serial.println(type);
+        return false;
+    }
+
+    uint8_t header[WAN_MESSAGE_HEADER_SIZE];
+    header[0] = WAN_MESSAGE_HEADER(type, WAN_MESSAGE_VERSION);
+    header[1] = size;
+
+    frame.append(header, WAN_MESSAGE_HEADER_SIZE);
+    frame.append(payload, size);
+
+    return true;
+}
+
+void WAN::setHandler(uint8_t type, WANMessageHandler handler) {
+    if (WAN_MESSAGE_TYPES <= type) {
+        Serial.print(F("Unknown message type: "));
+        Serial.println(type);
+        return;
+    }
+
+    WANHandler* slot = NULL;
+    for (uint8_t i = 0; i < WAN_HANDLERS_SIZE; i++) {
+        if (_handlers[i].handler && type == _handlers[i].type) {
+            slot = &_handlers[i];
+            break;
+        } else if (!slot && !_handlers[i].handler) {
+            slot = &_handlers[i];
+        }
+    }
+
+    if (!slot) {
+        Serial.print(F("Too many message handlers, type: "));
+        Serial.println(type);
+        return;
+    }
+
+    slot->type = type;
+    slot->handler = handler;
+}
+
+WANMessageHandler WAN::_findHandler(uint8_t type) {
+    for (uint8_t i = 0; i < WAN_HANDLERS_SIZE; i++) {
+        if (_handlers[i].handler && type == _handlers[i].type) {
+            return _handlers[i].handler;
+        }
+    }
+
+    return NULL;
+}
+
+void WAN::setStateMessage(uint8_t type) {
+    if (WAN_MESSAGE_TYPES <= type) {
+        Serial.print(F("Unknown message type: "));
+        Serial.println(type);
+        return;
+    }
+
+    _stateTypes |= 1 << type;
+}
+
+bool WAN::dispatch(Data &frame) {
+    if (!_isMessageFrame(frame)) {
+        WANMessageHandler handler = _findHandler(WAN_MESSAGE_TYPE_LEGACY);
+        if (!handler) {
+            return false;
+        }
+
+        (*handler)(WAN_MESSAGE_TYPE_LEGACY, frame);
+        return true;
+    }
+
+    bool handled = false;
+    uint8_t* data = frame.getData();
+    uint8_t pos = 0;
+
+    while (pos < frame.getSize()) {
+        uint8_t type   = WAN_MESSAGE_HEADER_TYPE(data[pos]);
+        uint8_t length = data[pos + 1];
+
+        if (WAN_MESSAGE_TYPE_DOWNLINK == type) {
+            // already handled by receive()
+        } else {
+            WANMessageHandler handler = _findHandler(type);
+            if (!handler) {
+                Serial.print(F("No handler for message type: "));
+                Serial.println(type);
+            } else {
+                Data message = Data();
+                message.borrow(frame.getAddress(), data + pos + WAN_MESSAGE_HEADER_SIZE, length);
+
+                (*handler)(type, message);
+                handled = true;
+            }
+        }
+
+        pos += WAN_MESSAGE_HEADER_SIZE + length;
+    }
+
+    return handled;
+}
+
+bool WAN::isAssociated() {
+    return _associated;
+}
+
+bool WAN::waitForAssociation(uint32_t timeout) {
+    uint32_t start = millis();
+    uint32_t pollTime = 0UL;
+    bool polled = false;
+
+    Data data = Data();
+    while (!_associated && millis() - start < timeout) {
+        if (!polled || millis() - pollTime >= WAN_ASSOCIATION_POLL_MILLIS) {
+            _sendCommand(0UL, "AI", NULL, 0);
+            pollTime = millis();
+            polled = true;
+        }
+
+        if (receive(data, WAN_ASSOCIATION_POLL_MILLIS) && !dispatch(data)) {
+            Serial.println(F("Received data was not handled"));
+        }
+    }
+
+    return _associated;
+}
+
+uint32_t WAN::getJoinTime() {
+    return _joinTime;
+}
+
+uint16_t WAN::getJoinCount() {
+    return _joinCount;
+}
+
+uint16_t WAN::getDisassociationCount() {
+    return _disassociationCount;
+}
+
+uint8_t WAN::sendCommand(const char* command, WANCommandCallback callback) {
+    return _queueCommand(0UL, command, NULL, 0, callback);
+}
+
+uint8_t WAN::sendCommand(const char* command, uint8_t* value, uint8_t length, WANCommandCallback callback) {
+    return _queueCommand(0UL, command, value, length, callback);
+}
+
+#ifdef XBEE_REMOTE_AT
+uint8_t WAN::sendRemoteCommand(uint32_t address, const char* command, WANCommandCallback callback) {
+    return _queueCommand(address, command, NULL, 0, callback);
+}
+
+uint8_t WAN::sendRemoteCommand(uint32_t address, const char* command, uint8_t* value, uint8_t length, WANCommandCallback callback) {
+    return _queueCommand(address, command, value, length, callback);
+}
+#endif
+
+bool WAN::negotiateBaudRate(uint32_t baud) {
+    uint8_t code = _getBaudRateCode(baud);
+    if (XBEE_BAUD_RATES == code) {
+        Serial.print(F("Unsupported baud rate: "));
+        Serial.println(baud);
+        return false;
+    }
+
+    if (!_findBaudRate(baud)) {
+        return false;
+    }
+
+    if (baud == _baudRate) {
+        Serial.print(F("XBee baud rate: "));
+        Serial.println(_baudRate);
+        return true;
+    }
+
+    uint32_t previous = _baudRate;
+    uint32_t timeout = _getProbeTimeout(previous);
+
+    // AC is answered at the old rate, then the new rate applies,
+    // only apply it once BD has accepted the rate
+    if (AT_OK != _waitForCommand("BD", &code, 1, timeout)) {
+        Serial.print(F("XBee baud rate not accepted, staying at: "));
+        Serial.println(previous);
+        return false;
+    }
+
+    _waitForCommand("AC", NULL, 0, timeout);
+
+    if (_probeBaudRate(baud)) {
+        Serial.print(F("XBee baud rate changed to: "));
+        Serial.println(_baudRate);
+        return true;
+    }
+
+    if (!_probeBaudRate(previous)) {
+        // it switched, but we can't hear it at the new rate,
+        // switch it back without waiting for the responses
+        code = _getBaudRateCode(previous);
+
+        _setBaudRate(baud);
+        _sendCommand(0UL, "BD", &code, 1);
+        _sendCommand(0UL, "AC", NULL, 0);
+
+        // only carry on once it answers, wherever it ended up
+        if (!_findBaudRate(previous)) {
+            Serial.println(F("XBee not found after the baud rate change"));
+            return false;
+        }
+    }
+
+    Serial.print(F("XBee baud rate not changed, staying at: "));
+    Serial.println(_baudRate);
+
+    return baud == _baudRate;
+}
+
+uint32_t WAN::getBaudRate() {
+    return _baudRate;
+}
+
+bool WAN::isCommandPending() {
+    for (uint8_t i = 0; i < WAN_COMMANDS_SIZE; i++) {
+        if (_commands[i].frameId) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+uint8_t WAN::verifySetting(const char* command, uint16_t expected) {
+    return verifySetting(0UL, command, expected);
+}
+
+uint8_t WAN::verifySetting(uint32_t address, const char* command, uint16_t expected) {
+    uint8_t frameId = _queueCommand(address, command, NULL, 0, NULL);
+    if (frameId) {
+        for (uint8_t i = 0; i < WAN_COMMANDS_SIZE; i++) {
+            if (frameId == _commands[i].frameId) {
+                _commands[i].verify = true;
+                _commands[i].expected = expected;
+            }
+        }
+    }
+
+    return frameId;
+}
+
+void WAN::discoverNodes() {
+    // the responses arrive over the next NT (discovery timeout)
+    _sendCommand(0UL, "ND", NULL, 0);
+}
+
+uint8_t WAN::getRole(uint32_t address) {
+    WANNode* node = _findNode(address);
+    return node && node->address ? node->role : WAN_ROLE_UNKNOWN;
+}
+
+uint8_t WAN::getInstance(uint32_t address) {
+    WANNode* node = _findNode(address);
+    return node && node->address ? node->instance : 0;
+}
+
+uint8_t WAN::getLinkRssi(uint32_t address) {
+    WANNode* node = _findNode(address);
+    if (!node || !node->address || node->rssiAge > WAN_LINK_RSSI_MAX_AGE) {
+        return 0;
+    }
+
+    return (node->rssi + 8) >> 4;
+}
+
+uint8_t WAN::getLinkRetries(uint32_t address) {
+    WANNode* node = _findNode(address);
+    return node && node->address ? min(node->retries, 0xFF) : 0;
+}
+
+uint32_t WAN::getAddress(uint8_t role, uint8_t instance) {
+    for (uint8_t i = 0; i < WAN_NODES_SIZE; i++) {
+        if (_nodes[i].address && role == _nodes[i].role && instance == _nodes[i].instance) {
+            return _nodes[i].address;
+        }
+    }
+
+    return 0UL;
+}
+
+uint8_t WAN::getNumNodes(uint8_t role) {
+    uint8_t count = 0;
+    for (uint8_t i = 0; i < WAN_NODES_SIZE; i++) {
+        if (_nodes[i].address && role == _nodes[i].role) {
+            count++;
+        }
+    }
+
+    return count;
+}
+
 uint32_t WAN::getBaseStationAddress() {
-    return XBEE_BASE_STATION_ADDRESS;
+    return getAddress(WAN_ROLE_BASE_STATION, 0);
 }
 
 uint32_t WAN::getRemoteSensorAddress() {
-    return XBEE_REMOTE_SENSOR_ADDRESS;
+    return getAddress(WAN_ROLE_REMOTE_SENSOR, 0);
 }
 
 uint32_t WAN::getPumpSwitchAddress() {
-    return XBEE_PUMP_SWITCH_ADDRESS;
+    return getAddress(WAN_ROLE_PUMP_SWITCH, 0);
 }
 
 bool WAN::isBaseStationAddress(uint32_t address) {
-    return XBEE_BASE_STATION_ADDRESS == address;
+    return WAN_ROLE_BASE_STATION == getRole(address);
 }
 
 bool WAN::isRemoteSensorAddress(uint32_t address) {
-    return XBEE_REMOTE_SENSOR_ADDRESS == address;
+    return WAN_ROLE_REMOTE_SENSOR == getRole(address);
 }
 
 bool WAN::isPumpSwitchAddress(uint32_t address) {
-    return XBEE_PUMP_SWITCH_ADDRESS == address;
+    return WAN_ROLE_PUMP_SWITCH == getRole(address);
 }
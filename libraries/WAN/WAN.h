@@ -7,6 +7,7 @@
 // local
 #include "LED.h"
 #include "Data.h"
+#include "Transport.h"
 
 /*
  * Constants
@@ -18,18 +19,335 @@
 #define XBEE_REMOTE_SENSOR_ADDRESS 0x40C59899UL
 #define XBEE_PUMP_SWITCH_ADDRESS   0x40C31683UL
 
-#define XBEE_SLEEP_DELAY_MILLIS 5000UL
-#define XBEE_WAKE_DELAY_MILLIS  10UL
+// Settings verified at boot, see notes/radios.md. The coordinator's
+// SP * SN is how long it remembers a sleeping end device, too short
+// and the remote sensor must re-join (5-10s) after sleeping.
+#define XBEE_COORDINATOR_SLEEP_PERIOD 0x0AF0 // SP, max (28s)
+#define XBEE_COORDINATOR_SLEEP_COUNT  0xFFFF // SN, max (~63 days)
+#define XBEE_END_DEVICE_SLEEP_MODE    1      // SM, pin hibernate
+
+// ZB TX request bytes for a 64-bit address (MSB first), and their
+// sum with the api id, computed at compile time for the fixed
+// addresses above, see XBee::sendZBTx_P()
+#define XBEE_BYTE(value, shift) ((uint8_t) (((value) >> (shift)) & 0xFF))
+#define XBEE_ADDRESS64_BYTES(lsb) \
+    XBEE_BYTE(XBEE_FAMILY_ADDRESS, 24), XBEE_BYTE(XBEE_FAMILY_ADDRESS, 16), \
+    XBEE_BYTE(XBEE_FAMILY_ADDRESS, 8),  XBEE_BYTE(XBEE_FAMILY_ADDRESS, 0),  \
+    XBEE_BYTE(lsb, 24), XBEE_BYTE(lsb, 16), XBEE_BYTE(lsb, 8), XBEE_BYTE(lsb, 0)
+#define XBEE_ADDRESS64_CHECKSUM(lsb) ((uint8_t) (ZB_TX_REQUEST + \
+    XBEE_BYTE(XBEE_FAMILY_ADDRESS, 24) + XBEE_BYTE(XBEE_FAMILY_ADDRESS, 16) + \
+    XBEE_BYTE(XBEE_FAMILY_ADDRESS, 8)  + XBEE_BYTE(XBEE_FAMILY_ADDRESS, 0)  + \
+    XBEE_BYTE(lsb, 24) + XBEE_BYTE(lsb, 16) + XBEE_BYTE(lsb, 8) + XBEE_BYTE(lsb, 0)))
+
+// Delivery status values, in addition to the XBee TX status
+// delivery status values (SUCCESS, NETWORK_ACK_FAILURE, ...)
+#define WAN_DELIVERY_UNKNOWN 0xFF // no TX status received (yet)
+#define WAN_DELIVERY_PENDING 0xFE // reliable transmit in progress
+#define WAN_DELIVERY_TIMEOUT 0xFD // no TX status before the timeout
+#define WAN_DELIVERY_DROPPED 0xFC // made room for a higher priority transmit
+
+// Reliable transmits are kept until delivered, or until
+// they fail WAN_RETRY_MAX_ATTEMPTS times. The retry delay
+// doubles after each failed attempt.
+//
+// The table sizes here (*_SIZE) can be set in a sketch's build
+// flags, a sketch which doesn't need as many saves the RAM.
+#ifndef WAN_PENDING_SIZE
+#define WAN_PENDING_SIZE             3
+#endif
+#define WAN_RETRY_MAX_ATTEMPTS       3
+#define WAN_RETRY_BACKOFF_MILLIS     1000UL
+#define WAN_TX_STATUS_TIMEOUT_MILLIS 10000UL
+
+// Queued transmits are sent highest priority first (oldest first
+// within a priority). When every slot is taken, a transmit drops
+// the lowest priority one not yet sent below its own.
+#define WAN_PRIORITY_LOW    0 // periodic telemetry
+#define WAN_PRIORITY_NORMAL 1
+#define WAN_PRIORITY_HIGH   2 // commands, state changes
+
+// The XBee sleeps as soon as every transmit has its TX status,
+// or at most this long after the last transmit/receive.
+#define XBEE_SLEEP_TIMEOUT_MILLIS 5000UL
+#define XBEE_WAKE_DELAY_MILLIS    10UL
+
+// Frames for a sleeping node (downlink) are held until it next
+// polls for them (WAN_MESSAGE_TYPE_DOWNLINK), it's only awake (and
+// polling its parent) for a short window afterwards. Its parent only
+// buffers frames for ~30s (SP), much less than the remote sensor
+// sleeps for.
+#ifndef WAN_DOWNLINK_SIZE
+#define WAN_DOWNLINK_SIZE          2
+#endif
+#define WAN_DOWNLINK_WINDOW_MILLIS 500UL
+
+// a held downlink frame, sent once its node is awake
+struct WANDownlink {
+    bool held;
+    Data data;
+};
+
+// Each radio frame carries one or more messages, each
+// message starts with a 2 byte header:
+//   [TYPE (high nibble) | VERSION (low nibble)][LENGTH][PAYLOAD...]
+//
+// Frames which don't parse as messages of this version, with
+// lengths adding up to the frame size, are from older firmware
+// and are dispatched as WAN_MESSAGE_TYPE_LEGACY.
+#define WAN_MESSAGE_HEADER_SIZE 2
+#define WAN_MESSAGE_VERSION     1
+#define WAN_MESSAGE_TYPES       16
+
+#define WAN_MESSAGE_TYPE_LEGACY 0
+
+// Downlink control, handled by WAN itself rather than dispatched.
+// A sleeping node adds a poll (see addDownlinkPoll()) when it will
+// stay awake for frames held for it, the node holding them replies
+// with an end once they're all sent, so the sleeping node needn't
+// wait out its receive window:
+//   [FLAGS]
+#define WAN_MESSAGE_TYPE_DOWNLINK 13
+#define WAN_DOWNLINK_POLL 0x01 // the sender is awake for held frames
+#define WAN_DOWNLINK_END  0x02 // nothing more is held for the receiver
+
+// IO samples from an XBee's own DIO/ADC pins (IR/IC), for nodes
+// without a microcontroller, are dispatched as messages of this
+// type, the digital values are only valid for the masked pins:
+//   [DIGITAL MASK MSB][LSB][DIGITAL MSB][LSB][ANALOG MASK][ANALOG MSB][LSB]...
+#define WAN_MESSAGE_TYPE_IO_SAMPLE 15
+#define WAN_IO_SAMPLE_DIGITAL_SIZE 5
+
+// Link statistics (see getStats()), sent by nodes so the base
+// station can tell which is using the most airtime and battery,
+// each value MSB first:
+//   [SENT 2][RECEIVED 2][TX FAILURES 2 x WAN_STATS_TX_FAILURES]
+//   [CHECKSUM ERRORS 2][START BYTE ERRORS 2][RECEIVE DROPPED 2]
+//   [TRANSPORT OVERFLOWS 2][WAKE MIN 2][WAKE AVG 2][WAKE MAX 2]
+//   [AWAKE MILLIS 4]
+#define WAN_MESSAGE_TYPE_STATS 14
+
+// failed transmits are counted by delivery status
+#define WAN_STATS_TX_NETWORK_ACK 0 // NETWORK_ACK_FAILURE
+#define WAN_STATS_TX_NOT_FOUND   1 // ADDRESS_NOT_FOUND, ROUTE_NOT_FOUND
+#define WAN_STATS_TX_TIMEOUT     2 // WAN_DELIVERY_TIMEOUT
+#define WAN_STATS_TX_OTHER       3
+#define WAN_STATS_TX_FAILURES    4
+
+#define WAN_STATS_SIZE (2 * (9 + WAN_STATS_TX_FAILURES) + 4)
+
+struct WANStats {
+    uint16_t sent;                // data frames
+    uint16_t received;            // data frames and IO samples
+    uint16_t txFailures[WAN_STATS_TX_FAILURES];
+    uint16_t checksumErrors;
+    uint16_t startByteErrors;     // frames cut short
+    uint16_t receiveDropped;      // receive queue full (or too large)
+    uint16_t transportOverflows;  // times bytes weren't read in time
+    uint16_t wakeMin;             // ms from waking the XBee until CTS,
+    uint16_t wakeAvg;             // 0 if it hasn't slept
+    uint16_t wakeMax;
+    uint32_t awakeMillis;         // the XBee has been awake in total
+};
+
+#define WAN_MESSAGE_HEADER(type, version) ((((type) & 0x0F) << 4) | ((version) & 0x0F))
+#define WAN_MESSAGE_HEADER_TYPE(header)    (((header) >> 4) & 0x0F)
+#define WAN_MESSAGE_HEADER_VERSION(header) ((header) & 0x0F)
+
+// called with the message payload, addressed from the sender
+typedef void (*WANMessageHandler)(uint8_t type, Data &message);
+
+// Message handlers registered (see setHandler()), the base
+// station handles the most types
+#ifndef WAN_HANDLERS_SIZE
+#define WAN_HANDLERS_SIZE 8
+#endif
+
+struct WANHandler {
+    uint8_t type;
+    WANMessageHandler handler; // NULL when the slot is free
+};
+
+// called with the final delivery status of a reliable transmit,
+// and the address it was sent to
+typedef void (*WANDeliveryCallback)(uint8_t frameId, uint32_t address, uint8_t status);
+
+// How often to ask the XBee if it has joined (AI) while
+// waiting for it to, in case the modem status was missed
+#define WAN_ASSOCIATION_POLL_MILLIS 500UL
+
+// AT commands waiting for their response, matched by frame id.
+// Remote commands can take a while (and sleeping nodes only
+// answer once awake), they fail with AT_NO_RESPONSE after the
+// timeout.
+#ifndef WAN_COMMANDS_SIZE
+#define WAN_COMMANDS_SIZE          4
+#endif
+#define WAN_COMMAND_TIMEOUT_MILLIS 5000UL
+
+// Serial link to the XBee, it starts at the factory default (BD 3)
+// and negotiateBaudRate() moves it to XBEE_BAUD_RATE. The rate is
+// applied (AC) but not written (WR), though any later WR (see
+// verifySetting()) keeps it. At boot the requested rate is probed
+// first (the XBee stays at it while only the MCU resets), then the
+// default (it's back there once power cycled), then the rest.
+// Each BD value is an index into the table of rates.
+#define XBEE_BAUD_RATE_DEFAULT 9600UL
+#define XBEE_BAUD_RATE         38400UL
+#define XBEE_BAUD_RATES        8
+
+// longest to wait for the XBee to answer at each rate probed, plus
+// the time on the wire for the BD query and response (bytes)
+#define WAN_BAUD_PROBE_TIMEOUT_MILLIS 50UL
+#define WAN_BAUD_PROBE_BYTES          20
+
+// called with the response to a local (address 0) or remote
+// AT command, value is only set for queries
+typedef void (*WANCommandCallback)(uint8_t frameId, uint32_t address, uint8_t status, uint8_t* value, uint8_t length);
+
+struct WANCommand {
+    uint8_t  frameId;   // 0 when the slot is free
+    uint32_t address;
+    uint32_t time;
+    WANCommandCallback callback;
+    bool     verify;    // verifySetting(), set expected if different
+    uint16_t expected;
+    char     command[2];
+};
+
+// Node roles, from the start of each XBee's node identifier (NI)
+// string. Digits straight after the role name are the instance,
+// e.g. "RemoteSensor2 EndUnit" is remote sensor 2 (no digits is 0).
+#define WAN_ROLE_UNKNOWN        0
+#define WAN_ROLE_BASE_STATION   1
+#define WAN_ROLE_REMOTE_SENSOR  2
+#define WAN_ROLE_PUMP_SWITCH    3
+
+#define WAN_NODE_ID_BASE_STATION   "BaseStation"
+#define WAN_NODE_ID_REMOTE_SENSOR  "RemoteSensor"
+#define WAN_NODE_ID_PUMP_SWITCH    "PumpSwitch"
+
+// Node registry, a hash table (open addressing) of every known node
+// by 64-bit address, seeded with the fixed addresses above and
+// filled in by node discovery (ND) and join announcements. Must be
+// a power of 2.
+#ifndef WAN_NODES_SIZE
+#define WAN_NODES_SIZE 8
+#endif
+
+// Link quality is averaged per node (EWMA), each new sample
+// counts for 1/2^WAN_LINK_EWMA_SHIFT of the average
+#define WAN_LINK_EWMA_SHIFT 3
+
+// RSSI is only sampled from frames received, so it's unknown again
+// once this many transmits to the node have gone without one
+#define WAN_LINK_RSSI_MAX_AGE 4
+
+struct WANNode {
+    uint32_t address;   // 0 when the entry is free
+    uint8_t  role;
+    uint8_t  instance;
+    uint16_t rssi;      // -dBm in 1/16ths, 0 until sampled
+    uint8_t  rssiAge;   // transmits since the last RSSI sample
+    uint16_t retries;   // per transmit in 1/16ths
+};
+
+// 64-bit to 16-bit network address cache, transmits to a cached
+// address skip the XBee's network address discovery. Learned from
+// received frames and TX statuses, forgotten when a transmit fails.
+#ifndef WAN_ADDRESS_CACHE_SIZE
+#define WAN_ADDRESS_CACHE_SIZE 4
+#endif
+
+struct WANAddress {
+    uint32_t address;   // 0 when the entry is free
+    uint16_t address16;
+};
+
+// precomputed ZB TX header for a fixed node, stored in PROGMEM
+struct WANTxHeader {
+    uint32_t address;
+    uint8_t  addr64[8];
+    uint8_t  checksum;
+};
+
+// pending transmit states
+#define WAN_PENDING_QUEUED 0 // waiting to be sent
+#define WAN_PENDING_SENT   1 // waiting for the TX status
+#define WAN_PENDING_RETRY  2 // waiting to be re-queued
+#define WAN_PENDING_DONE   3 // waiting for the status to be checked
+
+// async transmit states
+#define WAN_TX_IDLE   0
+#define WAN_TX_WAKING 1 // waiting for CTS after waking the XBee
+
+// an async transmit, from queued until its status is checked
+struct WANPending {
+    uint8_t  frameId;   // 0 when the slot is free
+    uint8_t  status;    // WAN_DELIVERY_PENDING until done
+    uint8_t  state;
+    uint8_t  attempts;
+    uint8_t  maxAttempts;
+    uint8_t  priority;
+    uint32_t time;      // when queued or sent, or when to retry
+    Data     data;
+};
 
 class WAN {
     private:
         LED _led;
 
         XBee _xbee;
+        XBeeResponse _packet;
         ZBRxResponse _zbRx;
+#ifdef XBEE_IO_SAMPLES
+        ZBRxIoSampleResponse _zbIoSample;
+#endif
         ZBTxStatusResponse _zbTxStatus;
+        AtCommandResponse _atResponse;
+        ModemStatusResponse _modemStatus;
+#ifdef XBEE_REMOTE_AT
+        RemoteAtCommandResponse _remoteAtResponse;
+#endif
+
+        Transport* _transport;
+
+        // counts already logged, see _checkReceiveErrors()
+        uint16_t _receiveErrors;
+        uint16_t _receiveDropped;
+        uint16_t _transportOverflows;
+
+        // received payloads larger than DATA_MAX_SIZE, dropped
+        uint16_t _receiveOversize;
+
+        bool _receive(Data &data, uint32_t timeout);
+        bool _nextPacket();
+        bool _waitForPackets(uint32_t timeout);
+#ifdef XBEE_IO_SAMPLES
+        void _getIoSample(Data &data);
+#endif
+        void _checkReceiveErrors();
+
+        // link statistics, see getStats()
+        uint16_t _framesSent;
+        uint16_t _framesReceived;
+        uint16_t _txFailures[WAN_STATS_TX_FAILURES];
 
-        void _init(Stream &serial);
+        uint16_t _wakeCount;
+        uint32_t _wakeTotal;
+        uint16_t _wakeMin;
+        uint16_t _wakeMax;
+
+        // the XBee's sleep pin (DTR) state, and how long it's been
+        // awake, until the current wake
+        bool     _asleep;
+        bool     _waking;
+        uint32_t _wokeTime;
+        uint32_t _awakeMillis;
+
+        void _countTxFailure(uint8_t status);
+        void _waitForLed();
+
+        void _init(Transport &transport);
 
         // With Sleep Mode = 1 (Pin), setting DTR
         // high will sleep the XBee.
@@ -41,13 +359,134 @@ class WAN {
 
         bool _sleepEnabled;
 
+        // delivery status of the last transmit
+        uint8_t  _deliveryStatus;
+        uint8_t  _deliveryFrameId;
+        uint32_t _deliveryAddress;
+
+        // association (network join) state, from modem
+        // statuses and AI responses
+        bool     _associated;
+        uint32_t _joinStartTime;
+        uint32_t _joinTime;
+        uint16_t _joinCount;
+        uint16_t _disassociationCount;
+
+        void     _setAssociated(bool associated);
+
+        WANCommand _commands[WAN_COMMANDS_SIZE];
+
+        uint8_t  _sendCommand(uint32_t address, const char* command, uint8_t* value, uint8_t length);
+        void     _sendCommand(uint8_t frameId, uint32_t address, const char* command, uint8_t* value, uint8_t length);
+        uint8_t  _queueCommand(uint32_t address, const char* command, uint8_t* value, uint8_t length, WANCommandCallback callback);
+        void     _handleCommandResponse(uint8_t frameId, uint32_t address, uint8_t status, uint8_t* value, uint8_t length);
+        void     _checkCommands();
+        void     _expireCommands(uint32_t address);
+
+        // the last command response, see _waitForCommand()
+        uint8_t  _responseFrameId;
+        uint8_t  _responseStatus;
+
+        uint8_t  _waitForCommand(const char* command, uint8_t* value, uint8_t length, uint32_t timeout);
+
+        uint32_t _baudRate;
+
+        uint32_t _getBaudRate(uint8_t code);
+        uint8_t  _getBaudRateCode(uint32_t baud);
+        uint32_t _getProbeTimeout(uint32_t baud);
+        void     _setBaudRate(uint32_t baud);
+        bool     _probeBaudRate(uint32_t baud);
+        bool     _findBaudRate(uint32_t baud);
+
+        WANNode _nodes[WAN_NODES_SIZE];
+
+        WANNode* _findNode(uint32_t address);
+        void     _registerNode(uint32_t address, uint8_t role, uint8_t instance);
+        void     _registerNode(uint32_t address, uint8_t* nodeId, uint8_t length);
+        void     _handleNodeIdentifier();
+        void     _handleNodeDiscovery();
+
+        // the sender of the last frame, until its RSSI is sampled,
+        // and the frame id of the DB command asking for it
+        uint32_t _rssiAddress;
+        uint8_t  _rssiFrameId;
+
+        void     _requestRssi();
+
+        WANNode* _getNode(uint32_t address);
+        void     _updateRssi(uint32_t address, uint8_t rssi);
+        void     _updateRetries(uint32_t address, uint8_t retries);
+
+        WANAddress _addresses[WAN_ADDRESS_CACHE_SIZE];
+        uint8_t    _nextAddress;
+
+        uint16_t _getAddress16(uint32_t address);
+        void     _learnAddress(uint32_t address, uint16_t address16);
+        void     _forgetAddress(uint32_t address);
+
+        WANPending _pending[WAN_PENDING_SIZE];
+        WANDeliveryCallback _deliveryCallback;
+
+        uint8_t  _txState;
+
+        // sleep once it's safe, or the timeout elapses
+        bool     _sleepRequested;
+        uint32_t _sleepTime;
+        uint32_t _sleepTimeout;
+
+        // stay awake this long after transmitting a downlink poll,
+        // until the end of the frames sent in reply is received
+        uint32_t _receiveWindow;
+        bool     _listening;
+
+        WANDownlink _downlinks[WAN_DOWNLINK_SIZE];
+
+        // the last node to poll, awake until the end queued
+        // for it (_awakeFrameId) is sent
+        uint32_t _awakeAddress;
+        uint8_t  _awakeFrameId;
+
+        uint8_t _getDownlinkFlags(Data &frame);
+        void _sendDownlinks(uint32_t address);
+
+        const WANTxHeader* _findTxHeader(uint32_t address);
+        void _sendFrame(Data *data, uint8_t frameId);
+        void _send(Data *data, uint8_t frameId);
+        uint8_t _queue(Data *data, uint8_t maxAttempts, uint8_t priority);
+        void _completePending(WANPending &pending, uint8_t status);
+        void _failPending(WANPending &pending, uint8_t status);
+        void _checkPending();
+        void _checkTransmit();
+        void _handleTxStatus();
+        WANPending* _findPending(uint8_t frameId);
+        WANPending* _findQueued();
+        WANPending* _findFree();
+        WANPending* _findLowerPriority(uint8_t priority);
+        WANPending* _findSuperseded(Data *data);
+
+        // message handlers, by message type
+        WANHandler _handlers[WAN_HANDLERS_SIZE];
+
+        WANMessageHandler _findHandler(uint8_t type);
+
+        bool _isMessageFrame(Data &frame);
+
+        // message types only carrying the latest state, as a mask
+        uint16_t _stateTypes;
+
+        uint16_t _getMessageTypes(Data &frame);
+
         // this is managed automatically, doesn't need to be public
         void _sleep();
         void _wake();
+        void _setAsleep(bool asleep);
+        void _checkAwake();
+        bool _isSleepSafe();
+        void _checkSleep();
 
     public:
-        WAN(Stream &serial);
-        WAN(Stream &serial, LED &statusLed);
+        WAN(Transport &transport);
+        WAN(Transport &transport, LED &statusLed);
         ~WAN();
 
         void setup();
@@ -57,13 +496,179 @@ class WAN {
         void enableSleep(uint8_t dtrPin, uint8_t ctsPin);
         void disableSleep();
 
+        // longest to keep the XBee awake waiting for TX statuses,
+        // receive() or check() sleeps it once they're all received
+        void setSleepTimeout(uint32_t timeout);
+
+        // true while the XBee is awake, waiting to sleep
+        bool isSleepPending();
+
+        // keep the XBee awake at most this long after transmitting
+        // a downlink poll, so frames held for it (see
+        // transmitDownlink()) are received before it sleeps again.
+        // It sleeps as soon as the end of them is received.
+        void setReceiveWindow(uint32_t window);
+
         void enableLed();
         void disableLed();
 
+        // receive the next data frame, packets received together
+        // are queued so later calls return them without waiting
         bool receive(Data &data);
         bool receive(Data &data, uint32_t timeout);
+
+        // receive and dispatch() every frame available, returns
+        // the number of frames received
+        uint8_t receiveAll();
+
+        // as receiveAll(), but if nothing is available yet the MCU
+        // idles until something is or the timeout elapses
+        uint8_t receiveAll(uint32_t timeout);
+
+        // packets dropped because the receive queue was full,
+        // and in total (including ones too large to queue, or
+        // with a payload too large for Data)
+        uint16_t getReceiveOverflowCount();
+        uint16_t getReceiveDroppedCount();
+
+        // how often the transport dropped received bytes before
+        // they were read (see Transport)
+        uint16_t getTransportOverflowCount();
+
+        // counters since startup, and as a WAN_MESSAGE_TYPE_STATS
+        // message (false if the frame doesn't have room for it)
+        void getStats(WANStats &stats);
+        bool addStats(Data &frame);
+
+        // the stats in a received WAN_MESSAGE_TYPE_STATS message,
+        // false if it's the wrong size
+        bool readStats(Data &message, WANStats &stats);
+
         bool transmit(Data *data);
 
+        // delivery status of the last transmit, only known once
+        // its TX status has been received
+        uint8_t getDeliveryStatus();
+        bool    isDelivered();
+
+        // queue a transmit without blocking, check() sends it and
+        // both check() and receive() must be called regularly to
+        // process the TX status (and retries). Returns the frame id
+        // to poll the delivery status with, or 0 if too many
+        // transmits are already pending.
+        uint8_t transmitAsync(Data *data);
+
+        // as transmitAsync(), but retried until delivered
+        uint8_t transmitReliable(Data *data);
+
+        // as above, sent ahead of lower priority transmits
+        // (WAN_PRIORITY_NORMAL otherwise)
+        uint8_t transmitAsync(Data *data, uint8_t priority);
+        uint8_t transmitReliable(Data *data, uint8_t priority);
+
+        // as transmitAsync(), but for a sleeping node. Sent as soon
+        // as it next polls (or now, if it just did), returns false
+        // if too many frames are already held.
+        bool    transmitDownlink(Data *data);
+
+        // append a downlink poll to the frame, so frames held for
+        // this node are sent in reply and the receive window is
+        // kept open (false if the frame doesn't have room for it)
+        bool    addDownlinkPoll(Data &frame);
+
+        // true while queued transmits are waiting to be sent
+        bool    isTransmitting();
+
+        // WAN_DELIVERY_PENDING until the transmit completes, the
+        // final status is only returned once.
+        uint8_t getDeliveryStatus(uint8_t frameId);
+        void    setDeliveryCallback(WANDeliveryCallback callback);
+
+        // append a message to the frame, returns false if
+        // the frame doesn't have room for it
+        bool addMessage(Data &frame, uint8_t type, uint8_t* payload, uint8_t size);
+
+        // call the handler registered for each message in
+        // the frame, returns false if nothing handled it. At most
+        // WAN_HANDLERS_SIZE types can have a handler, a NULL
+        // handler removes the type's.
+        void setHandler(uint8_t type, WANMessageHandler handler);
+        bool dispatch(Data &frame);
+
+        // messages of this type carry the sender's latest state, a
+        // queued transmit (not yet sent) whose messages are all
+        // repeated in a later one to the same node is replaced by
+        // it, keeping its place and frame id
+        void setStateMessage(uint8_t type);
+
+        // true once the XBee has joined the network, and until it
+        // reports it has left
+        bool     isAssociated();
+
+        // wait for the XBee to join the network, handling anything
+        // received meanwhile. Returns false if it hasn't joined
+        // before the timeout.
+        bool     waitForAssociation(uint32_t timeout);
+
+        // how long the last join took (ms), counted from startup or
+        // leaving the network, and how often it has joined/left
+        uint32_t getJoinTime();
+        uint16_t getJoinCount();
+        uint16_t getDisassociationCount();
+
+        // send an AT command to the local XBee, or to a remote
+        // node, without waiting for the response. The callback
+        // (if any) is called with the response, or AT_NO_RESPONSE
+        // after WAN_COMMAND_TIMEOUT_MILLIS. Returns the frame id,
+        // or 0 if too many commands are waiting for responses.
+        uint8_t  sendCommand(const char* command, WANCommandCallback callback);
+        uint8_t  sendCommand(const char* command, uint8_t* value, uint8_t length, WANCommandCallback callback);
+#ifdef XBEE_REMOTE_AT
+        uint8_t  sendRemoteCommand(uint32_t address, const char* command, WANCommandCallback callback);
+        uint8_t  sendRemoteCommand(uint32_t address, const char* command, uint8_t* value, uint8_t length, WANCommandCallback callback);
+#endif
+
+        // find the XBee's serial rate and switch it (and the
+        // transport) to baud, falling back to the rate it was found
+        // at, once it answers there again. Blocks for up to a second
+        // or so (a few probes when the XBee is at baud or the
+        // default), call it before enableSleep(). Returns false if
+        // it isn't at baud.
+        bool     negotiateBaudRate(uint32_t baud);
+
+        // serial rate of the XBee link
+        uint32_t getBaudRate();
+
+        // true while commands are waiting for their responses
+        bool     isCommandPending();
+
+        // query a setting, and if it isn't the expected value set
+        // it and write it to the XBee's non-volatile memory (WR).
+        // Remote settings need XBEE_REMOTE_AT, or they time out.
+        uint8_t  verifySetting(const char* command, uint16_t expected);
+        uint8_t  verifySetting(uint32_t address, const char* command, uint16_t expected);
+
+        // ask the XBee for every node on the network (ND), the
+        // responses are registered as they're received
+        void discoverNodes();
+
+        // role/instance of a node, WAN_ROLE_UNKNOWN if not registered
+        uint8_t  getRole(uint32_t address);
+        uint8_t  getInstance(uint32_t address);
+
+        // link quality averages for a node, the RSSI (-dBm) of
+        // frames received from it (0 if unknown, or not sampled in
+        // the last WAN_LINK_RSSI_MAX_AGE transmits) and the retries
+        // per transmit to it in 1/16ths
+        uint8_t  getLinkRssi(uint32_t address);
+        uint8_t  getLinkRetries(uint32_t address);
+
+        // address of a node (the last registered, e.g. discovered
+        // rather than hard-coded), 0 if not registered
+        uint32_t getAddress(uint8_t role, uint8_t instance);
+        uint8_t  getNumNodes(uint8_t role);
+
+        // instance 0 of each role
         uint32_t getBaseStationAddress();
         uint32_t getRemoteSensorAddress();
         uint32_t getPumpSwitchAddress();
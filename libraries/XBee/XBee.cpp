@@ -177,6 +177,7 @@ void XBeeResponse::getZBRxResponse(XBeeResponse &rxResponse) {
 }
 
 
+#ifdef XBEE_IO_SAMPLES
 ZBRxIoSampleResponse::ZBRxIoSampleResponse() : ZBRxResponse() {
 
 }
@@ -263,6 +264,7 @@ void XBeeResponse::getZBRxIoSampleResponse(XBeeResponse &response) {
 	zb->getRemoteAddress64().setMsb((uint32_t(getFrameData()[0]) << 24) + (uint32_t(getFrameData()[1]) << 16) + (uint16_t(getFrameData()[2]) << 8) + getFrameData()[3]);
 	zb->getRemoteAddress64().setLsb((uint32_t(getFrameData()[4]) << 24) + (uint32_t(getFrameData()[5]) << 16) + (uint16_t(getFrameData()[6]) << 8) + (getFrameData()[7]));
 }
+#endif
 
 #endif
 
@@ -288,6 +290,7 @@ Rx16Response::Rx16Response() : RxResponse() {
 
 }
 
+#ifdef XBEE_IO_SAMPLES
 RxIoSampleBaseResponse::RxIoSampleBaseResponse() : RxResponse() {
 
 }
@@ -510,6 +513,7 @@ void XBeeResponse::getRx64IoSampleResponse(XBeeResponse &response) {
 	rx->getRemoteAddress64().setMsb((uint32_t(getFrameData()[0]) << 24) + (uint32_t(getFrameData()[1]) << 16) + (uint16_t(getFrameData()[2]) << 8) + getFrameData()[3]);
 	rx->getRemoteAddress64().setLsb((uint32_t(getFrameData()[4]) << 24) + (uint32_t(getFrameData()[5]) << 16) + (uint16_t(getFrameData()[6]) << 8) + getFrameData()[7]);
 }
+#endif
 
 TxStatusResponse::TxStatusResponse() : FrameIdResponse() {
 
@@ -589,6 +593,7 @@ void XBeeResponse::getRx64Response(XBeeResponse &rx64Response) {
 
 #endif
 
+#ifdef XBEE_REMOTE_AT
 RemoteAtCommandResponse::RemoteAtCommandResponse() : AtCommandResponse() {
 
 }
@@ -640,6 +645,7 @@ void XBeeResponse::getRemoteAtCommandResponse(XBeeResponse &response) {
 	at->getRemoteAddress64().setLsb((uint32_t(getFrameData()[5]) << 24) + (uint32_t(getFrameData()[6]) << 16) + (uint16_t(getFrameData()[7]) << 8) + (getFrameData()[8]));
 
 }
+#endif
 
 RxDataResponse::RxDataResponse() : XBeeResponse() {
 
@@ -757,8 +763,16 @@ void XBee::resetResponse() {
 XBee::XBee(): _response(XBeeResponse()) {
         _pos = 0;
         _escape = false;
+        _escaped = ATAP == 2;
         _checksumTotal = 0;
         _nextFrameId = 0;
+        _queueHead = 0;
+        _queueCount = 0;
+        _queueOverflows = 0;
+        _queueOversizes = 0;
+        _packetErrors = 0;
+        _checksumErrors = 0;
+        _startByteErrors = 0;
 
         _response.init();
         _response.setFrameData(_responseFrameData);
@@ -791,6 +805,15 @@ void XBee::setSerial(Stream &serial) {
 	_serial = &serial;
 }
 
+void XBee::setApiMode(uint8_t apiMode) {
+	_escaped = apiMode == 2;
+	_escape = false;
+}
+
+uint8_t XBee::getApiMode() {
+	return _escaped ? 2 : 1;
+}
+
 bool XBee::available() {
 	return _serial->available();
 }
@@ -853,108 +876,250 @@ bool XBee::readPacket(int timeout) {
 }
 
 void XBee::readPacket() {
-	// reset previous response
-	if (_response.isAvailable() || _response.isError()) {
-		// discard previous packet and start over
-		resetResponse();
-	}
+	prepareResponse();
 
     while (available()) {
 
         b = read();
 
-        if (_pos > 0 && b == START_BYTE && ATAP == 2) {
-        	// new packet start before previous packeted completed -- discard previous packet and start over
-        	_response.setErrorCode(UNEXPECTED_START_BYTE);
+        if (parseByte(b)) {
         	return;
         }
+    }
+}
 
-		if (_pos > 0 && b == ESCAPE) {
-			if (available()) {
-				b = read();
-				b = 0x20 ^ b;
+uint8_t XBee::parse(const uint8_t* data, uint16_t length) {
+	uint8_t queued = 0;
+
+	for (uint16_t i = 0; i < length; i++) {
+		prepareResponse();
+
+		if (parseByte(data[i])) {
+			if (_response.isAvailable()) {
+				queued+= queuePacket();
 			} else {
-				// escape byte.  next byte will be
-				_escape = true;
-				continue;
+				countPacketError();
 			}
 		}
+	}
 
-		if (_escape == true) {
-			b = 0x20 ^ b;
-			_escape = false;
-		}
+	return queued;
+}
+
+void XBee::prepareResponse() {
+	// reset previous response
+	if (_response.isAvailable() || _response.isError()) {
+		// the start byte which aborted the previous packet begins the next one
+		bool started = _response.getErrorCode() == UNEXPECTED_START_BYTE;
 
-		// checksum includes all bytes starting with api id
-		if (_pos >= API_ID_INDEX) {
-			_checksumTotal+= b;
+		// discard previous packet and start over
+		resetResponse();
+
+		if (started) {
+			_pos = 1;
 		}
+	}
+}
 
-        switch(_pos) {
-			case 0:
-		        if (b == START_BYTE) {
-		        	_pos++;
-		        }
+bool XBee::parseByte(uint8_t value) {
+	if (_pos > 0 && value == START_BYTE && _escaped) {
+		// new packet start before previous packeted completed -- discard previous packet and start over
+		_response.setErrorCode(UNEXPECTED_START_BYTE);
+		return true;
+	}
 
-		        break;
-			case 1:
-				// length msb
-				_response.setMsbLength(b);
-				_pos++;
+	// AP=1 frames aren't escaped, 0x7d is just data
+	if (_pos > 0 && value == ESCAPE && _escaped) {
+		// escape byte.  next byte will be
+		_escape = true;
+		return false;
+	}
 
-				break;
-			case 2:
-				// length lsb
-				_response.setLsbLength(b);
-				_pos++;
+	if (_escape == true) {
+		value = 0x20 ^ value;
+		_escape = false;
+	}
 
-				break;
-			case 3:
-				_response.setApiId(b);
+	// checksum includes all bytes starting with api id
+	if (_pos >= API_ID_INDEX) {
+		_checksumTotal+= value;
+	}
+
+	switch(_pos) {
+		case 0:
+			if (value == START_BYTE) {
 				_pos++;
+			}
 
-				break;
-			default:
-				// starts at fifth byte
+			break;
+		case 1:
+			// length msb
+			_response.setMsbLength(value);
+			_pos++;
+
+			break;
+		case 2:
+			// length lsb
+			_response.setLsbLength(value);
+			_pos++;
+
+			break;
+		case 3:
+			_response.setApiId(value);
+			_pos++;
+
+			break;
+		default:
+			// starts at fifth byte
+
+			if (_pos > MAX_FRAME_DATA_SIZE) {
+				// exceed max size.  should never occur
+				_response.setErrorCode(PACKET_EXCEEDS_BYTE_ARRAY_LENGTH);
+				return true;
+			}
 
-				if (_pos > MAX_FRAME_DATA_SIZE) {
-					// exceed max size.  should never occur
-					_response.setErrorCode(PACKET_EXCEEDS_BYTE_ARRAY_LENGTH);
-					return;
+			// check if we're at the end of the packet
+			// packet length does not include start, length, or checksum bytes, so add 3
+			if (_pos == (_response.getPacketLength() + 3)) {
+				// verify checksum
+
+				if ((_checksumTotal & 0xff) == 0xff) {
+					_response.setChecksum(value);
+					_response.setAvailable(true);
+
+					_response.setErrorCode(NO_ERROR);
+				} else {
+					// checksum failed
+					_response.setErrorCode(CHECKSUM_FAILURE);
 				}
 
-				// check if we're at the end of the packet
-				// packet length does not include start, length, or checksum bytes, so add 3
-				if (_pos == (_response.getPacketLength() + 3)) {
-					// verify checksum
+				// minus 4 because we start after start,msb,lsb,api and up to but not including checksum
+				// e.g. if frame was one byte, _pos=4 would be the byte, pos=5 is the checksum, where end stop reading
+				_response.setFrameLength(_pos - 4);
+
+				// reset state vars
+				_pos = 0;
 
-					//std::cout << "read checksum " << static_cast<unsigned int>(b) << " at pos " << static_cast<unsigned int>(_pos) << std::endl;
+				return true;
+			} else {
+				// add to packet array, starting with the fourth byte of the apiFrame
+				_response.getFrameData()[_pos - 4] = value;
+				_pos++;
+			}
+	}
 
-					if ((_checksumTotal & 0xff) == 0xff) {
-						_response.setChecksum(b);
-						_response.setAvailable(true);
+	return false;
+}
 
-						_response.setErrorCode(NO_ERROR);
-					} else {
-						// checksum failed
-						_response.setErrorCode(CHECKSUM_FAILURE);
-					}
+uint8_t XBee::readPackets() {
+	uint8_t queued = 0;
 
-					// minus 4 because we start after start,msb,lsb,api and up to but not including checksum
-					// e.g. if frame was one byte, _pos=4 would be the byte, pos=5 is the checksum, where end stop reading
-					_response.setFrameLength(_pos - 4);
+	// once the queue is full the rest is left in the serial buffer,
+	// for the next call after nextPacket() has made room
+	while (_queueCount < XBEE_RX_QUEUE_SIZE && available()) {
+		readPacket();
 
-					// reset state vars
-					_pos = 0;
+		if (_response.isAvailable()) {
+			queued+= queuePacket();
+		} else if (_response.isError()) {
+			countPacketError();
+		}
+	}
 
-					return;
-				} else {
-					// add to packet array, starting with the fourth byte of the apiFrame
-					_response.getFrameData()[_pos - 4] = b;
-					_pos++;
-				}
-        }
-    }
+	return queued;
+}
+
+uint8_t XBee::readPackets(int timeout) {
+
+	if (timeout < 0) {
+		return 0;
+	}
+
+	unsigned long start = millis();
+
+	uint8_t queued = readPackets();
+
+	while (!queued && int((millis() - start)) < timeout) {
+		queued = readPackets();
+	}
+
+	return queued;
+}
+
+void XBee::countPacketError() {
+	_packetErrors++;
+
+	if (_response.getErrorCode() == CHECKSUM_FAILURE) {
+		_checksumErrors++;
+	} else if (_response.getErrorCode() == UNEXPECTED_START_BYTE) {
+		_startByteErrors++;
+	}
+}
+
+bool XBee::queuePacket() {
+	if (_response.getFrameDataLength() > XBEE_RX_QUEUE_FRAME_SIZE) {
+		_queueOversizes++;
+		return false;
+	}
+
+	if (_queueCount == XBEE_RX_QUEUE_SIZE) {
+		_queueOverflows++;
+		return false;
+	}
+
+	QueuedPacket &packet = _queue[(_queueHead + _queueCount) % XBEE_RX_QUEUE_SIZE];
+	packet.apiId = _response.getApiId();
+	packet.frameLength = _response.getFrameDataLength();
+	memcpy(packet.frameData, _response.getFrameData(), packet.frameLength);
+
+	_queueCount++;
+
+	return true;
+}
+
+bool XBee::nextPacket(XBeeResponse &response) {
+	if (_queueCount == 0) {
+		return false;
+	}
+
+	QueuedPacket &packet = _queue[_queueHead];
+	_queueHead = (_queueHead + 1) % XBEE_RX_QUEUE_SIZE;
+	_queueCount--;
+
+	// packet length includes the api id
+	response.reset();
+	response.setMsbLength(0);
+	response.setLsbLength(packet.frameLength + 1);
+	response.setApiId(packet.apiId);
+	response.setFrameLength(packet.frameLength);
+	response.setFrameData(packet.frameData);
+	response.setAvailable(true);
+
+	return true;
+}
+
+uint8_t XBee::getQueuedPackets() {
+	return _queueCount;
+}
+
+uint16_t XBee::getQueueOverflowCount() {
+	return _queueOverflows;
+}
+
+uint16_t XBee::getQueueOversizeCount() {
+	return _queueOversizes;
+}
+
+uint16_t XBee::getPacketErrorCount() {
+	return _packetErrors;
+}
+
+uint16_t XBee::getChecksumErrorCount() {
+	return _checksumErrors;
+}
+
+uint16_t XBee::getStartByteErrorCount() {
+	return _startByteErrors;
 }
 
 // it's peanut butter jelly time!!
@@ -1316,6 +1481,7 @@ uint8_t AtCommandRequest::getFrameDataLength() {
 	return AT_COMMAND_API_LENGTH + _commandValueLength;
 }
 
+#ifdef XBEE_REMOTE_AT
 XBeeAddress64 RemoteAtCommandRequest::broadcastAddress64 = XBeeAddress64(0x0, BROADCAST_ADDRESS);
 
 RemoteAtCommandRequest::RemoteAtCommandRequest() : AtCommandRequest(NULL, NULL, 0) {
@@ -1413,6 +1579,7 @@ uint8_t RemoteAtCommandRequest::getFrameData(uint8_t pos) {
 uint8_t RemoteAtCommandRequest::getFrameDataLength() {
 	return REMOTE_AT_COMMAND_API_LENGTH + getCommandValueLength();
 }
+#endif
 
 
 // TODO
@@ -1429,12 +1596,12 @@ void XBee::send(XBeeRequest &request) {
 	uint8_t msbLen = ((request.getFrameDataLength() + 2) >> 8) & 0xff;
 	uint8_t lsbLen = (request.getFrameDataLength() + 2) & 0xff;
 
-	sendByte(msbLen, true);
-	sendByte(lsbLen, true);
+	sendByte(msbLen, _escaped);
+	sendByte(lsbLen, _escaped);
 
 	// api id
-	sendByte(request.getApiId(), true);
-	sendByte(request.getFrameId(), true);
+	sendByte(request.getApiId(), _escaped);
+	sendByte(request.getFrameId(), _escaped);
 
 	uint8_t checksum = 0;
 
@@ -1442,30 +1609,61 @@ void XBee::send(XBeeRequest &request) {
 	checksum+= request.getApiId();
 	checksum+= request.getFrameId();
 
-	//std::cout << "frame length is " << static_cast<unsigned int>(request.getFrameDataLength()) << std::endl;
-
 	for (int i = 0; i < request.getFrameDataLength(); i++) {
-//		std::cout << "sending byte [" << static_cast<unsigned int>(i) << "] " << std::endl;
-		sendByte(request.getFrameData(i), true);
-		checksum+= request.getFrameData(i);
+		uint8_t b = request.getFrameData(i);
+		sendByte(b, _escaped);
+		checksum+= b;
 	}
 
 	// perform 2s complement
 	checksum = 0xff - checksum;
 
-//	std::cout << "checksum is " << static_cast<unsigned int>(checksum) << std::endl;
-
 	// send checksum
-	sendByte(checksum, true);
+	sendByte(checksum, _escaped);
 
 	// send packet (Note: prior to Arduino 1.0 this flushed the incoming buffer, which of course was not so great)
 	flush();
 }
 
+#ifdef SERIES_2
+
+void XBee::sendZBTx_P(uint8_t frameId, const uint8_t* addr64, uint8_t addr64Checksum, uint16_t addr16, uint8_t broadcastRadius, uint8_t option, uint8_t *payload, uint8_t payloadLength) {
+	uint8_t length = ZB_TX_API_LENGTH + payloadLength + 2;
+
+	sendByte(START_BYTE, false);
+	sendByte(0, _escaped);
+	sendByte(length, _escaped);
+	sendByte(ZB_TX_REQUEST, _escaped);
+	sendByte(frameId, _escaped);
+
+	// the api id and 64-bit address are already summed
+	uint8_t checksum = addr64Checksum + frameId;
+
+	for (uint8_t i = 0; i < 8; i++) {
+		sendByte(pgm_read_byte(addr64 + i), _escaped);
+	}
+
+	uint8_t options[] = { (uint8_t) ((addr16 >> 8) & 0xff), (uint8_t) (addr16 & 0xff), broadcastRadius, option };
+	for (uint8_t i = 0; i < sizeof(options); i++) {
+		sendByte(options[i], _escaped);
+		checksum+= options[i];
+	}
+
+	for (uint8_t i = 0; i < payloadLength; i++) {
+		sendByte(payload[i], _escaped);
+		checksum+= payload[i];
+	}
+
+	sendByte(0xff - checksum, _escaped);
+
+	flush();
+}
+
+#endif
+
 void XBee::sendByte(uint8_t b, bool escape) {
 
 	if (escape && (b == START_BYTE || b == ESCAPE || b == XON || b == XOFF)) {
-//		std::cout << "escaping byte [" << toHexString(b) << "] " << std::endl;
 		write(ESCAPE);
 		write(b ^ 0x20);
 	} else {
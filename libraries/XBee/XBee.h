@@ -28,11 +28,22 @@
 
 #include <inttypes.h>
 
+// Frame types compiled into the library, to save flash/RAM on sketches which
+// don't use them. Series 1, IO sample and remote AT command frames are only
+// compiled when XBEE_SERIES_1, XBEE_IO_SAMPLES and XBEE_REMOTE_AT are defined
+// (e.g. with cppflags in a sketch's ino.ini).
+#ifdef XBEE_SERIES_1
 #define SERIES_1
+#endif
 #define SERIES_2
 
 // set to ATAP value of XBee. AP=2 is recommended
+// AP=1 frames aren't escaped, which saves the escaping per byte (and the
+// frame growth) when flow control makes it unnecessary. This is the default,
+// see XBee::setApiMode() to change it at runtime.
+#ifndef ATAP
 #define ATAP 2
+#endif
 
 #define START_BYTE 0x7e
 #define ESCAPE 0x7d
@@ -47,6 +58,22 @@
 // This value is determined by the largest packet size (100 byte payload + 64-bit address + option byte and rssi byte) of a series 1 radio
 #define MAX_FRAME_DATA_SIZE 110
 
+// Complete packets are queued by readPackets() so back-to-back packets (e.g. a
+// TX status followed by an RX packet) aren't lost before they're consumed.
+// readPackets() stops reading while the queue is full, so later packets wait in
+// the serial buffer instead, a sketch which handles each packet as it's
+// read (e.g. with WAN) can set XBEE_RX_QUEUE_SIZE to 1 in its build flags.
+// Each queued packet takes XBEE_RX_QUEUE_FRAME_SIZE + 2 bytes of RAM, packets
+// with more frame data than this are dropped (and counted) by readPackets().
+// The default fits a ZB RX packet with a 32 byte payload, and a node
+// identification indicator with a 20 character NI.
+#ifndef XBEE_RX_QUEUE_SIZE
+#define XBEE_RX_QUEUE_SIZE 3
+#endif
+#ifndef XBEE_RX_QUEUE_FRAME_SIZE
+#define XBEE_RX_QUEUE_FRAME_SIZE 52
+#endif
+
 #define BROADCAST_ADDRESS 0xffff
 #define ZB_BROADCAST_ADDRESS 0xfffe
 
@@ -215,12 +242,14 @@ public:
 	 * to populate response
 	 */
 	void getZBRxResponse(XBeeResponse &response);
+#ifdef XBEE_IO_SAMPLES
 	/**
 	 * Call with instance of ZBRxIoSampleResponse class only if getApiId() == ZB_IO_SAMPLE_RESPONSE
 	 * to populate response
 	 */
 	void getZBRxIoSampleResponse(XBeeResponse &response);
 #endif
+#endif
 #ifdef SERIES_1
 	/**
 	 * Call with instance of TxStatusResponse only if getApiId() == TX_STATUS_RESPONSE
@@ -234,6 +263,7 @@ public:
 	 * Call with instance of Rx64Response only if getApiId() == RX_64_RESPONSE
 	 */
 	void getRx64Response(XBeeResponse &response);
+#ifdef XBEE_IO_SAMPLES
 	/**
 	 * Call with instance of Rx16IoSampleResponse only if getApiId() == RX_16_IO_RESPONSE
 	 */
@@ -242,15 +272,18 @@ public:
 	 * Call with instance of Rx64IoSampleResponse only if getApiId() == RX_64_IO_RESPONSE
 	 */
 	void getRx64IoSampleResponse(XBeeResponse &response);
+#endif
 #endif
 	/**
 	 * Call with instance of AtCommandResponse only if getApiId() == AT_COMMAND_RESPONSE
 	 */
 	void getAtCommandResponse(XBeeResponse &responses);
+#ifdef XBEE_REMOTE_AT
 	/**
 	 * Call with instance of RemoteAtCommandResponse only if getApiId() == REMOTE_AT_COMMAND_RESPONSE
 	 */
 	void getRemoteAtCommandResponse(XBeeResponse &response);
+#endif
 	/**
 	 * Call with instance of ModemStatusResponse only if getApiId() == MODEM_STATUS_RESPONSE
 	 */
@@ -387,6 +420,7 @@ private:
 	XBeeAddress64 _remoteAddress64;
 };
 
+#ifdef XBEE_IO_SAMPLES
 /**
  * Represents a Series 2 RX I/O Sample packet
  */
@@ -417,6 +451,7 @@ public:
 	uint8_t getDigitalMaskLsb();
 	uint8_t getAnalogMask();
 };
+#endif
 
 #endif
 
@@ -471,6 +506,7 @@ private:
 	XBeeAddress64 _remoteAddress;
 };
 
+#ifdef XBEE_IO_SAMPLES
 /**
  * Represents a Series 1 RX I/O Sample packet
  */
@@ -521,6 +557,7 @@ public:
 private:
 	XBeeAddress64 _remoteAddress;
 };
+#endif
 
 #endif
 
@@ -563,6 +600,7 @@ class AtCommandResponse : public FrameIdResponse {
 		bool isOk();
 };
 
+#ifdef XBEE_REMOTE_AT
 /**
  * Represents a Remote AT Command RX packet
  */
@@ -602,6 +640,7 @@ class RemoteAtCommandResponse : public AtCommandResponse {
 	private:
 		XBeeAddress64 _remoteAddress64;
 };
+#endif
 
 
 /**
@@ -699,6 +738,55 @@ public:
 	 * call forever!! often it's better to use a timeout: readPacket(int)
 	 */
 	void readPacketUntilAvailable();
+	/**
+	 * Reads the available serial bytes, queuing every complete packet instead of stopping at the
+	 * first one. Returns the number of packets queued. Use nextPacket() to consume them.
+	 * <p/>
+	 * Reading stops while the queue is full, leaving the rest in the serial buffer. Packets
+	 * too large for the queue are dropped, see getQueueOversizeCount().
+	 */
+	uint8_t readPackets();
+	/**
+	 * Parses a span of raw API frame bytes (e.g. a UART ring buffer or a capture file) with the same
+	 * state machine as readPacket, queuing every complete packet as readPackets() does. Packets may
+	 * span calls. Returns the number of packets queued.
+	 */
+	uint8_t parse(const uint8_t* data, uint16_t length);
+	/**
+	 * As readPackets(), but waits a maximum of <i>timeout</i> milliseconds for a packet to be queued
+	 */
+	uint8_t readPackets(int timeout);
+	/**
+	 * Removes the oldest queued packet into <i>response</i>, returns false if none are queued.
+	 * The current response (and any packet still being parsed) is untouched.
+	 * Note: the frame data is only valid until readPackets is called again!
+	 */
+	bool nextPacket(XBeeResponse &response);
+	/**
+	 * Returns the number of queued packets
+	 */
+	uint8_t getQueuedPackets();
+	/**
+	 * Returns the number of packets dropped because the queue was full (by parse(), readPackets()
+	 * stops reading instead)
+	 */
+	uint16_t getQueueOverflowCount();
+	/**
+	 * Returns the number of packets dropped because they were too large to queue
+	 */
+	uint16_t getQueueOversizeCount();
+	/**
+	 * Returns the number of packets which failed to parse (e.g. checksum failures)
+	 */
+	uint16_t getPacketErrorCount();
+	/**
+	 * Returns the number of packet errors which were checksum failures
+	 */
+	uint16_t getChecksumErrorCount();
+	/**
+	 * Returns the number of packet errors which were packets cut short by a start byte
+	 */
+	uint16_t getStartByteErrorCount();
 	/**
 	 * Starts the serial connection on the specified serial port
 	 */
@@ -710,9 +798,20 @@ public:
 	 */
 	XBeeResponse& getResponse();
 	/**
-	 * Sends a XBeeRequest (TX packet) out the serial port
+	 * Sends a XBeeRequest (TX packet) out the serial port, a byte at a time as it's
+	 * escaped. The frame isn't built in a buffer first: SoftwareSerial has no bulk
+	 * write, so the buffer would only cost stack.
 	 */
 	void send(XBeeRequest &request);
+#ifdef SERIES_2
+	/**
+	 * Sends a ZB TX request to a 64-bit address stored in PROGMEM (8 bytes, MSB first).
+	 * <i>addr64Checksum</i> is the sum of ZB_TX_REQUEST and the 8 address bytes, both are
+	 * expected to be computed at compile time for fixed nodes so only the frame id, options
+	 * and payload are read and summed per transmit.
+	 */
+	void sendZBTx_P(uint8_t frameId, const uint8_t* addr64, uint8_t addr64Checksum, uint16_t addr16, uint8_t broadcastRadius, uint8_t option, uint8_t *payload, uint8_t payloadLength);
+#endif
 	//uint8_t sendAndWaitForResponse(XBeeRequest &request, int timeout);
 	/**
 	 * Returns a sequential frame id between 1 and 255
@@ -722,6 +821,12 @@ public:
 	 * Specify the serial port.  Only relevant for Arduinos that support multiple serial ports (e.g. Mega)
 	 */
 	void setSerial(Stream &serial);
+	/**
+	 * Sets the framing used to send and parse packets, must match the ATAP value of the XBee:
+	 * 1 (unescaped) or 2 (escaped). Defaults to ATAP.
+	 */
+	void setApiMode(uint8_t apiMode);
+	uint8_t getApiMode();
 private:
 	bool available();
 	uint8_t read();
@@ -729,8 +834,12 @@ private:
 	void write(uint8_t val);
 	void sendByte(uint8_t b, bool escape);
 	void resetResponse();
+	void prepareResponse();
+	bool parseByte(uint8_t value);
 	XBeeResponse _response;
 	bool _escape;
+	// true for AP=2, frames are escaped
+	bool _escaped;
 	// current packet position for response.  just a state variable for packet parsing and has no relevance for the response otherwise
 	uint8_t _pos;
 	// last byte read
@@ -740,6 +849,22 @@ private:
 	// buffer for incoming RX packets.  holds only the api specific frame data, starting after the api id byte and prior to checksum
 	uint8_t _responseFrameData[MAX_FRAME_DATA_SIZE];
 	Stream* _serial;
+	// queue of complete packets, see readPackets()
+	struct QueuedPacket {
+		uint8_t apiId;
+		uint8_t frameLength;
+		uint8_t frameData[XBEE_RX_QUEUE_FRAME_SIZE];
+	};
+	bool queuePacket();
+	void countPacketError();
+	QueuedPacket _queue[XBEE_RX_QUEUE_SIZE];
+	uint8_t _queueHead;
+	uint8_t _queueCount;
+	uint16_t _queueOverflows;
+	uint16_t _queueOversizes;
+	uint16_t _packetErrors;
+	uint16_t _checksumErrors;
+	uint16_t _startByteErrors;
 };
 
 /**
@@ -915,6 +1040,7 @@ private:
 	uint8_t _commandValueLength;
 };
 
+#ifdef XBEE_REMOTE_AT
 /**
  * Represents an Remote AT Command TX packet
  * The command is used to configure a remote XBee radio
@@ -957,6 +1083,7 @@ private:
 	uint16_t _remoteAddress16;
 	bool _applyChanges;
 };
+#endif
 
 
 
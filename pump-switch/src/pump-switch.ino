@@ -21,6 +21,7 @@
 #include "Danaides.h"
 #include "LED.h"
 #include "PumpSwitch.h"
+#include "Transport.h"
 #include "WAN.h"
 
 /*
@@ -67,18 +68,26 @@ void setupUnusedPins() {
 // XBee will use SoftwareSerial for communications, reserve the HardwareSerial
 // for debugging w/FTDI interface.
 SoftwareSerial ss(SS_RX_PIN, SS_TX_PIN);
+SoftwareSerialTransport transport(ss);
 
 LED statusLed = LED(STATUS_LED);
 
-WAN wan = WAN(ss, statusLed);
+WAN wan = WAN(transport, statusLed);
 
 void setupWAN() {
     // software serial is used for XBee communications
     pinMode(SS_RX_PIN, INPUT);
     pinMode(SS_TX_PIN, OUTPUT);
-    ss.begin(9600);
+    transport.begin(XBEE_BAUD_RATE_DEFAULT);
 
     wan.setup();
+
+    // less time on the wire for every frame, at 9600 if the XBee
+    // can't be switched
+    wan.negotiateBaudRate(XBEE_BAUD_RATE);
+
+    // logged and fixed when the response arrives
+    wan.verifySetting("SM", XBEE_END_DEVICE_SLEEP_MODE);
 }
 
 /*
@@ -153,37 +162,49 @@ void updateCounter() {
     counter.check(pumpSwitch.isOn(), elapsedSeconds);
 }
 
-void receive() {
-    uint32_t lastReceiveTime = millis();
-
-    Data data = Data();
-    if (wan.receive(data)) {
-        Serial.println(F("Received data..."));
-        Serial.flush();
+/*
+ * Message handlers, called by WAN for each message received.
+ */
 
-        freeRam(FREE_RAM_ENABLE);
+// update the local PumpSwitch object, the base station may have
+// enabled/disabled the pump
+void receivePumpValues(uint8_t type, Data &message) {
+    Serial.println(F("New values from Base Station"));
+    pumpSwitch.updateValues(message.getData(), message.getSize());
+    Serial.println(F("Updated Pump Switch values"));
+}
 
-        if (wan.isBaseStationAddress(data.getAddress())) {
-            Serial.println(F("New data from Base Station"));
-            if (data.getSize() == pumpSwitch.getNumValues()) {
-                // update the local PumpSwitch object, the base station may have
-                // enabled/disabled the pump
-                pumpSwitch.updateValues(data.getData(), data.getSize());
-                Serial.println(F("Updated Pump Switch values"));
-            }
-        } else if (wan.isRemoteSensorAddress(data.getAddress())) {
-            Serial.println(F("New data from Remote Sensor"));
-            // nothing to do
-        } else if (wan.isPumpSwitchAddress(data.getAddress())) {
-            Serial.println(F("New data from Pump Switch"));
-            // we're the pump switch, this would be weird
+/*
+ * Data from older firmware doesn't have message headers, the
+ * sender and size of the data determine what it is.
+ */
+void receiveLegacy(uint8_t type, Data &data) {
+    if (wan.isBaseStationAddress(data.getAddress())) {
+        if (data.getSize() == pumpSwitch.getNumValues()) {
+            receivePumpValues(type, data);
         }
+    }
+}
 
-        for (uint8_t i = 0; i < data.getSize(); i++) {
-            Serial.print(i);
-            Serial.print(F(":\t"));
-            Serial.println(data.getData()[i]);
-        }
+void setupHandlers() {
+    wan.setHandler(WAN_MESSAGE_TYPE_LEGACY,  receiveLegacy);
+    wan.setHandler(MESSAGE_TYPE_PUMP_VALUES, receivePumpValues);
+
+    // a queued update is replaced by a newer one, only the
+    // latest values & settings are sent
+    wan.setStateMessage(MESSAGE_TYPE_PUMP_VALUES);
+    wan.setStateMessage(MESSAGE_TYPE_PUMP_SETTINGS);
+}
+
+void receive() {
+    uint32_t lastReceiveTime = millis();
+
+    // handle every frame received since the last loop, idling
+    // briefly if there aren't any yet
+    uint8_t received = wan.receiveAll(RECEIVE_IDLE_TIMEOUT_MS);
+    if (received) {
+        Serial.print(F("Received frames: "));
+        Serial.println(received);
 
         freeRam(FREE_RAM_ENABLE);
 
@@ -194,12 +215,12 @@ void receive() {
 }
 
 /*
- * Transmit Values & Settings to the base station.
+ * Transmit Values & Settings to the base station, both
+ * are sent together in a single frame.
  */
 uint32_t lastTransmitTime = 0;
-bool lastTransmittedSettings = false;
-void transmit(bool forceValues = false) {
-    if (forceValues || !lastTransmitTime || millis() - lastTransmitTime > PUMP_SWITCH_TRANSMIT_INTERVAL_SECONDS * 1000UL) {
+void transmit(bool force = false) {
+    if (force || !lastTransmitTime || millis() - lastTransmitTime > PUMP_SWITCH_TRANSMIT_INTERVAL_SECONDS * 1000UL) {
         lastTransmitTime = millis();
 
         Serial.println(F("transmitting..."));
@@ -207,27 +228,19 @@ void transmit(bool forceValues = false) {
 
         freeRam(FREE_RAM_ENABLE);
 
-        // alternate between sending the values & sending the settings,
-        // don't send them back-to-back b/c base-station may not process
-        // the incoming messages fast enough.
-        if (forceValues || lastTransmittedSettings) {
-            lastTransmittedSettings = false;
-
-            Data values = Data(wan.getBaseStationAddress(), pumpSwitch.getValues(), pumpSwitch.getNumValues());
-            if (wan.transmit(&values)) {
-                Serial.println(F("PumpSwitch values sent!"));
-            } else {
-                Serial.println(F("Failed to transmit values"));
-            }
+        Data frame = Data();
+        frame.setAddress(wan.getBaseStationAddress());
+        wan.addMessage(frame, MESSAGE_TYPE_PUMP_VALUES, pumpSwitch.getValues(), pumpSwitch.getNumValues());
+        wan.addMessage(frame, MESSAGE_TYPE_PUMP_SETTINGS, pumpSwitch.getSettings(), pumpSwitch.getNumSettings());
+
+        // pump state changes are retried until the base station receives
+        // them (and sent first), periodic updates are not since another
+        // is sent soon. Neither blocks, wan.check() sends them from the loop.
+        bool queued = force ? wan.transmitReliable(&frame, WAN_PRIORITY_HIGH) : wan.transmitAsync(&frame, WAN_PRIORITY_LOW);
+        if (queued) {
+            Serial.println(F("PumpSwitch values & settings queued!"));
         } else {
-            lastTransmittedSettings = true;
-
-            Data settings = Data(wan.getBaseStationAddress(), pumpSwitch.getSettings(), pumpSwitch.getNumSettings());
-            if (wan.transmit(&settings)) {
-                Serial.println(F("PumpSwitch settings sent!"));
-            } else {
-                Serial.println(F("Failed to transmit settings"));
-            }
+            Serial.println(F("Failed to transmit values & settings"));
         }
 
         freeRam(FREE_RAM_ENABLE);
@@ -238,6 +251,27 @@ void transmit(bool forceValues = false) {
     }
 }
 
+/*
+ * Link statistics for the base station, periodically
+ * and behind anything else queued.
+ */
+uint32_t lastStatsTime = 0UL;
+void transmitStats() {
+    if (millis() - lastStatsTime < STATS_TRANSMIT_INTERVAL_MINUTES * 60UL * 1000UL) {
+        return;
+    }
+
+    lastStatsTime = millis();
+
+    Data frame = Data();
+    frame.setAddress(wan.getBaseStationAddress());
+    wan.addStats(frame);
+
+    if (!wan.transmitAsync(&frame, WAN_PRIORITY_LOW)) {
+        Serial.println(F("Failed to transmit stats"));
+    }
+}
+
 /*
  * Pump Relay
  */
@@ -276,6 +310,8 @@ void setup() {
 
     setupWAN();
 
+    setupHandlers();
+
     Serial.println(F("setup() completed!"));
 }
 
@@ -283,11 +319,14 @@ void loop() {
     settingsSwitchesCheck();
 
     pumpSwitch.check();
+    wan.check();
 
     updateCounter();
 
     receive();
 
     transmit();
+
+    transmitStats();
 }
 
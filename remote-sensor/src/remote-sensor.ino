@@ -25,6 +25,7 @@
 #include "InputShiftRegister.h"
 #include "LED.h"
 #include "TankSensors.h"
+#include "Transport.h"
 #include "WAN.h"
 
 /*
@@ -80,18 +81,24 @@ uint32_t now() {
 // XBee will use SoftwareSerial for communications, reserve the HardwareSerial
 // for debugging w/FTDI interface.
 SoftwareSerial ss(SS_RX_PIN, SS_TX_PIN);
+SoftwareSerialTransport transport(ss);
 
 // XXX remove eventually, this consumes too much power
 // for battery use...
 LED statusLed = LED(STATUS_LED);
 
-WAN wan = WAN(ss, statusLed);
+WAN wan = WAN(transport, statusLed);
+
+// XBee transmit power (PL), see adaptPowerLevel()
+uint8_t powerLevel = REMOTE_SENSOR_POWER_LEVEL_MAX;
+uint8_t strongReports = 0;
+bool lastDelivered = true;
 
 void setupWAN() {
     // software serial is used for XBee communications
     pinMode(SS_RX_PIN, INPUT);
     pinMode(SS_TX_PIN, OUTPUT);
-    ss.begin(9600);
+    transport.begin(XBEE_BAUD_RATE_DEFAULT);
 
     // force the XBee not *NOT* sleep during WAN
     // setup so it has time to join the network.
@@ -100,15 +107,37 @@ void setupWAN() {
     
     wan.setup();
 
+    // less time on the wire for every frame, at 9600 if the XBee
+    // can't be switched
+    wan.negotiateBaudRate(XBEE_BAUD_RATE);
+
     // by default, LED should be disabled
     wan.disableLed();
 
-    // wait before sleeping to allow XBee enough time to 
-    // join the network, otherwise it can take many wake/sleep
-    // cycles to finally join (or never join!).
-    delay(30000); // 30 seconds
+    // wait for the XBee to join the network before sleeping,
+    // otherwise it can take many wake/sleep cycles to finally
+    // join (or never join!).
+    if (!wan.waitForAssociation(REMOTE_SENSOR_JOIN_TIMEOUT_MS)) {
+        Serial.println(F("XBee has not joined, sleeping anyway"));
+    }
+
+    // sleeping only works in pin hibernate mode, check it
+    // before relying on it
+    wan.verifySetting("SM", XBEE_END_DEVICE_SLEEP_MODE);
+
+    // start at full power
+    wan.sendCommand("PL", &powerLevel, 1, NULL);
+
+    while (wan.isCommandPending()) {
+        wan.receiveAll();
+        wan.check();
+    }
 
     wan.enableSleep(SLEEP_PIN, CTS_PIN);
+
+    // the base station replies to a downlink poll with any commands
+    // held for us, stay awake until they're received (or at most this)
+    wan.setReceiveWindow(WAN_DOWNLINK_WINDOW_MILLIS);
 }
 
 /*
@@ -174,35 +203,175 @@ void displaySensorValues() {
     }
 }
 
+/*
+ * Commands from the base station, received after transmitting
+ */
+uint32_t checkIntervalSeconds = REMOTE_SENSOR_CHECK_INTERVAL_SECONDS;
+bool reportRequested = false;
+void receiveCommand(uint8_t type, Data &message) {
+    uint8_t* command = message.getData();
+    if (!message.getSize()) {
+        return;
+    }
+
+    switch (command[0]) {
+        case SENSOR_COMMAND_REPORT:
+            Serial.println(F("Report requested"));
+            reportRequested = true;
+            break;
+        case SENSOR_COMMAND_INTERVAL:
+            if (3 == message.getSize()) {
+                uint32_t seconds = ((uint32_t)command[1] << 8) | command[2];
+                checkIntervalSeconds = max(seconds, REMOTE_SENSOR_MIN_CHECK_INTERVAL_SECONDS);
+
+                Serial.print(F("Check interval (s): "));
+                Serial.println(checkIntervalSeconds);
+            }
+            break;
+        default:
+            Serial.print(F("Unknown command: "));
+            Serial.println(command[0]);
+            break;
+    }
+}
+
+void setupHandlers() {
+    wan.setHandler(MESSAGE_TYPE_SENSOR_COMMAND, receiveCommand);
+}
+
+/*
+ * Lower the XBee's transmit power after REMOTE_SENSOR_POWER_LOWER_REPORTS
+ * reports in a row over a strong link to the base station, and raise it
+ * again as soon as retries climb or a transmit fails. An unknown (or
+ * stale) RSSI isn't a strong link. Changed while the XBee is awake to
+ * transmit, the link stats are from the previous transmits.
+ */
+void adaptPowerLevel() {
+    uint32_t address = wan.getBaseStationAddress();
+    uint8_t retries = wan.getLinkRetries(address);
+    uint8_t rssi = wan.getLinkRssi(address);
+
+    uint8_t level = powerLevel;
+    if (!lastDelivered || retries >= REMOTE_SENSOR_POWER_RAISE_RETRIES) {
+        strongReports = 0;
+
+        if (level < REMOTE_SENSOR_POWER_LEVEL_MAX) {
+            level++;
+        }
+    } else if (retries <= REMOTE_SENSOR_POWER_LOWER_RETRIES && rssi && rssi <= REMOTE_SENSOR_POWER_LOWER_RSSI) {
+        if (++strongReports >= REMOTE_SENSOR_POWER_LOWER_REPORTS) {
+            strongReports = 0;
+
+            if (level > REMOTE_SENSOR_POWER_LEVEL_MIN) {
+                level--;
+            }
+        }
+    } else {
+        strongReports = 0;
+    }
+
+    if (level != powerLevel) {
+        powerLevel = level;
+
+        Serial.print(F("Transmit power level: "));
+        Serial.println(powerLevel);
+
+        wan.sendCommand("PL", &powerLevel, 1, NULL);
+    }
+}
+
 /*
  * Check if the sensorValues changed, or FORCE_TRANSMIT_INTERVAL_SECONDS has elapsed
- * since the last sensorValues change, and transmit the sensorValues to the base station.
+ * since the last key frame, and transmit the sensorValues to the base station.
+ *
+ * Key frames (all sensor values) are sent periodically and when confirming,
+ * otherwise only the sensors which changed since the last delivered frame are sent.
  */
-uint32_t lastTransmitTime = 0UL;
+uint32_t lastKeyFrameTime = 0UL;
 bool transmitSensorValues(bool force = false, bool confirm = false) {
-    if (force || now() - lastTransmitTime >= REMOTE_SENSOR_FORCE_TRANSMIT_INTERVAL_SECONDS * 1000UL) {
-        lastTransmitTime = now();
+    bool keyFrame = confirm || reportRequested || now() - lastKeyFrameTime >= REMOTE_SENSOR_FORCE_TRANSMIT_INTERVAL_SECONDS * 1000UL;
 
-        if (confirm) {
-            // enable the LED so we can see the status
-            wan.enableLed();
-        }
+    if (!force && !keyFrame) {
+        return false;
+    }
+
+    if (keyFrame) {
+        lastKeyFrameTime = now();
+        reportRequested = false;
+    }
+
+    if (confirm) {
+        // enable the LED so we can see the status
+        wan.enableLed();
+    }
+
+    adaptPowerLevel();
 
-        Data values = Data(wan.getBaseStationAddress(), tankSensors.getSensorValues(), tankSensors.getNumSensors());
+    Data sensorFrame = Data();
+    uint8_t type = tankSensors.getFrame(sensorFrame, keyFrame);
 
-        if (!wan.transmit(&values)) {
-            Serial.println(F("Failed to transmit values"));
+    Data values = Data();
+    values.setAddress(wan.getBaseStationAddress());
+    wan.addMessage(values, type, sensorFrame.getData(), sensorFrame.getSize());
+
+    // every report polls for commands, so a key frame requested
+    // when a delta is rejected is asked for (and sent, see loop())
+    // straight away. With nothing held the base station only
+    // replies with the end, so this costs a round trip awake.
+    wan.addDownlinkPoll(values);
+
+    if (!wan.transmit(&values)) {
+        Serial.println(F("Failed to transmit values"));
+    }
+
+    // picks up the delivery status and any commands sent in reply,
+    // WAN will blink LED appropriately for success/failure, and
+    // sleeps the XBee once the commands (if polled for) are received
+    Data data = Data();
+    while (wan.isSleepPending()) {
+        if (wan.receive(data, REMOTE_SENSOR_RECEIVE_TIMEOUT_MS)) {
+            wan.dispatch(data);
         }
+    }
+
+    // the next delta frame is built from the last delivered frame
+    tankSensors.acknowledge(wan.isDelivered());
+    lastDelivered = wan.isDelivered();
 
-        if (confirm) {
-            // data is ignored
-            Data data = Data();
+    if (confirm) {
+        // and then disable it again
+        wan.disableLed();
+    }
+
+    return wan.isDelivered();
+}
+
+/*
+ * Link statistics for the base station, sent in their own frame
+ * (they don't fit alongside a key frame) every
+ * STATS_TRANSMIT_INTERVAL_MINUTES.
+ */
+uint32_t lastStatsTime = 0UL;
+void transmitStats() {
+    if (now() - lastStatsTime < STATS_TRANSMIT_INTERVAL_MINUTES * 60UL * 1000UL) {
+        return;
+    }
+
+    lastStatsTime = now();
 
-            // WAN will blink LED appropriately for success/failure
-            wan.receive(data, REMOTE_SENSOR_RECEIVE_TIMEOUT_MS);
+    Data frame = Data();
+    frame.setAddress(wan.getBaseStationAddress());
+    wan.addStats(frame);
 
-            // and then disable it again
-            wan.disableLed();
+    if (!wan.transmit(&frame)) {
+        Serial.println(F("Failed to transmit stats"));
+    }
+
+    // the XBee sleeps once the TX status is received
+    Data data = Data();
+    while (wan.isSleepPending()) {
+        if (wan.receive(data, REMOTE_SENSOR_RECEIVE_TIMEOUT_MS)) {
+            wan.dispatch(data);
         }
     }
 }
@@ -214,7 +383,7 @@ void sleepArduino() {
     // allow serial buffer to flush before sleeping
     Serial.flush();
 
-    Narcoleptic.delay(REMOTE_SENSOR_CHECK_INTERVAL_SECONDS * 1000UL);
+    Narcoleptic.delay(checkIntervalSeconds * 1000UL);
 }
 
 void setup() {
@@ -232,6 +401,8 @@ void setup() {
 
     setupWAN();
 
+    setupHandlers();
+
     Serial.println(F("setup() completed!"));
 }
 
@@ -249,6 +420,16 @@ void loop() {
 
     transmitSensorValues();
 
+    // a report may have been requested in reply to the last transmit
+    if (reportRequested) {
+        transmitSensorValues();
+    }
+
+    transmitStats();
+
+    // retries, and commands which were never answered
+    wan.check();
+
     sleepArduino();
 }
 
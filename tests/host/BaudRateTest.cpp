@@ -0,0 +1,192 @@
+// negotiateBaudRate() finds the XBee in a probe or two when it's at
+// the requested rate or the default, only applies (AC) a rate BD has
+// accepted, and only gives up on a new rate once the XBee answers
+// at the one it falls back to.
+
+// system
+#include <assert.h>
+
+// local
+#include "FakeTransport.h"
+#include "WAN.h"
+
+static const uint32_t rates[XBEE_BAUD_RATES] = { 1200, 2400, 4800, 9600, 19200, 38400, 57600, 115200 };
+
+/*
+ * An XBee which only hears (and is only heard) at its own rate,
+ * answering BD and AC.
+ */
+class SimulatedXBee : public FakeTransport {
+    private:
+        XBee _parser;
+        int  _pendingCode;
+
+        void _handle(XBeeResponse &request) {
+            uint8_t* data = request.getFrameData();
+            if (AT_COMMAND_REQUEST != request.getApiId()) {
+                return;
+            }
+
+            Bytes value;
+            uint8_t status = AT_OK;
+            uint32_t apply = 0;
+
+            if ('B' == data[1] && 'D' == data[2]) {
+                if (request.getFrameDataLength() > 3) {
+                    if (data[3] == rejectCode) {
+                        status = AT_INVALID_PARAMETER;
+                    } else {
+                        _pendingCode = data[3];
+                        sets++;
+                    }
+                } else {
+                    queries++;
+                    for (uint8_t code = 0; code < XBEE_BAUD_RATES; code++) {
+                        if (rates[code] == rate) {
+                            value.push_back(code);
+                        }
+                    }
+                }
+            } else if ('A' == data[1] && 'C' == data[2]) {
+                applies++;
+                if (_pendingCode >= 0) {
+                    apply = rates[_pendingCode];
+                    _pendingCode = -1;
+                }
+            }
+
+            // answered at the old rate, then the new one applies
+            if (rate != deafRate) {
+                atResponse(data[0], (const char*) data + 1, status, value);
+            }
+            if (apply) {
+                rate = apply;
+            }
+        }
+
+    public:
+        uint32_t rate;       // 0 if there's no XBee
+        uint32_t deafRate;   // rate it can't be heard at
+        int      rejectCode; // BD value it refuses
+
+        int begins;
+        int queries;
+        int sets;
+        int applies;
+
+        SimulatedXBee(uint32_t rate) : _pendingCode(-1),
+                                       rate(rate),
+                                       deafRate(0),
+                                       rejectCode(-1),
+                                       begins(0),
+                                       queries(0),
+                                       sets(0),
+                                       applies(0) {
+        }
+
+        void begin(uint32_t baud) {
+            FakeTransport::begin(baud);
+            begins++;
+        }
+
+        int available() {
+            return baud == rate ? in.size() : 0;
+        }
+
+        int read() {
+            if (baud != rate) {
+                in.clear();
+                return -1;
+            }
+
+            return FakeTransport::read();
+        }
+
+        size_t write(uint8_t b) {
+            if (baud == rate) {
+                XBeeResponse request;
+                _parser.parse(&b, 1);
+                while (_parser.nextPacket(request)) {
+                    _handle(request);
+                }
+            }
+
+            return 1;
+        }
+};
+
+int main() {
+    fakeTick = 1;
+
+    // factory default: the requested rate, then the default
+    {
+        SimulatedXBee xbee(XBEE_BAUD_RATE_DEFAULT);
+        WAN wan(xbee);
+        assert(wan.negotiateBaudRate(38400));
+        assert(38400 == xbee.rate && 38400 == xbee.baud && 38400 == wan.getBaudRate());
+        assert(3 == xbee.begins && 2 == xbee.queries);
+        assert(!wan.isCommandPending());
+    }
+
+    // already there (only the MCU reset): a single probe
+    {
+        SimulatedXBee xbee(38400);
+        WAN wan(xbee);
+        unsigned long start = millis();
+        assert(wan.negotiateBaudRate(38400));
+        assert(1 == xbee.begins && 1 == xbee.queries && 0 == xbee.sets);
+        assert(millis() - start < WAN_BAUD_PROBE_TIMEOUT_MILLIS);
+    }
+
+    // anywhere else: the rest are searched
+    {
+        SimulatedXBee xbee(19200);
+        WAN wan(xbee);
+        assert(wan.negotiateBaudRate(57600));
+        assert(57600 == xbee.rate && 57600 == wan.getBaudRate());
+    }
+
+    // BD refuses the rate: AC isn't sent, still answering at the default
+    {
+        SimulatedXBee xbee(XBEE_BAUD_RATE_DEFAULT);
+        xbee.rejectCode = 5;
+        WAN wan(xbee);
+        assert(!wan.negotiateBaudRate(38400));
+        assert(0 == xbee.applies);
+        assert(XBEE_BAUD_RATE_DEFAULT == xbee.rate && XBEE_BAUD_RATE_DEFAULT == wan.getBaudRate());
+    }
+
+    // switched, but can't be heard at the new rate: switched back
+    // blind, and only given up on once it answers at the old one
+    {
+        SimulatedXBee xbee(XBEE_BAUD_RATE_DEFAULT);
+        xbee.deafRate = 115200;
+        WAN wan(xbee);
+        assert(!wan.negotiateBaudRate(115200));
+        assert(XBEE_BAUD_RATE_DEFAULT == xbee.rate && XBEE_BAUD_RATE_DEFAULT == xbee.baud);
+        assert(XBEE_BAUD_RATE_DEFAULT == wan.getBaudRate());
+
+        int queries = xbee.queries;
+        assert(wan.negotiateBaudRate(XBEE_BAUD_RATE_DEFAULT));
+        assert(queries + 1 == xbee.queries);
+    }
+
+    // no XBee at all: left at the default
+    {
+        SimulatedXBee xbee(0);
+        WAN wan(xbee);
+        assert(!wan.negotiateBaudRate(38400));
+        assert(XBEE_BAUD_RATE_DEFAULT == wan.getBaudRate());
+        assert(1 + XBEE_BAUD_RATES == xbee.begins);
+    }
+
+    // not a rate the XBee supports
+    {
+        SimulatedXBee xbee(XBEE_BAUD_RATE_DEFAULT);
+        WAN wan(xbee);
+        assert(!wan.negotiateBaudRate(12345));
+        assert(0 == xbee.begins);
+    }
+
+    return 0;
+}
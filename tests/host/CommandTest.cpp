@@ -0,0 +1,70 @@
+// flags: -DXBEE_IO_SAMPLES -DXBEE_REMOTE_AT
+//
+// Local commands hold the XBee awake until they're answered, and
+// are failed (freeing their slot) when it sleeps without an answer.
+// Built with the optional IO sample and remote AT frames, which no
+// other test compiles.
+
+// system
+#include <assert.h>
+
+// local
+#include "FakeTransport.h"
+#include "WAN.h"
+
+static uint8_t responses = 0;
+static uint8_t lastStatus = AT_OK;
+
+static void onResponse(uint8_t /* frameId */, uint32_t /* address */, uint8_t status, uint8_t* /* value */, uint8_t /* length */) {
+    responses++;
+    lastStatus = status;
+}
+
+// as the remote sensor does after each transmit
+static void receiveUntilAsleep(WAN &wan) {
+    Data data;
+    while (wan.isSleepPending()) {
+        if (wan.receive(data, 100)) {
+            wan.dispatch(data);
+        }
+    }
+}
+
+int main() {
+    fakeTick = 1;
+
+    FakeTransport transport;
+    WAN wan(transport);
+    wan.enableSleep(17, 16);
+
+    uint8_t level = 2;
+
+    // answered: the XBee stays awake for the response
+    uint8_t frameId = wan.sendCommand("PL", &level, 1, onResponse);
+    assert(frameId);
+    Data data;
+    wan.receive(data);
+    assert(wan.isSleepPending() && wan.isCommandPending());
+
+    transport.atResponse(frameId, "PL", AT_OK);
+    receiveUntilAsleep(wan);
+    assert(1 == responses && AT_OK == lastStatus);
+    assert(!wan.isCommandPending());
+
+    // never answered: failed when the sleep timeout puts it to sleep,
+    // no check() needed
+    for (uint8_t i = 0; i < WAN_COMMANDS_SIZE; i++) {
+        assert(wan.sendCommand("PL", &level, 1, onResponse));
+        receiveUntilAsleep(wan);
+    }
+
+    assert(1 + WAN_COMMANDS_SIZE == responses && AT_NO_RESPONSE == lastStatus);
+    assert(!wan.isCommandPending());
+
+    // and a late response is ignored
+    transport.atResponse(frameId, "PL", AT_OK);
+    receiveUntilAsleep(wan);
+    assert(1 + WAN_COMMANDS_SIZE == responses);
+
+    return 0;
+}
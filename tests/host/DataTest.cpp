@@ -0,0 +1,183 @@
+// flags: -Wl,--wrap=malloc -Wl,--wrap=calloc -Wl,--wrap=realloc
+//
+// Data and the WAN receive/transmit paths never allocate, over
+// millions of cycles the heap doesn't move (the host's stand-in
+// for a flat freeRam() curve).
+
+// system
+#include <assert.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <new>
+
+// local
+#include "Data.h"
+#include "FakeTransport.h"
+#include "WAN.h"
+
+#define DATA_CYCLES 2000000UL
+#define WAN_CYCLES  1000000UL
+#define SAMPLES     10
+
+static unsigned long allocations = 0;
+
+extern "C" void* __real_malloc(size_t size);
+extern "C" void* __real_calloc(size_t count, size_t size);
+extern "C" void* __real_realloc(void* p, size_t size);
+
+extern "C" void* __wrap_malloc(size_t size) {
+    allocations++;
+    return __real_malloc(size);
+}
+
+extern "C" void* __wrap_calloc(size_t count, size_t size) {
+    allocations++;
+    return __real_calloc(count, size);
+}
+
+extern "C" void* __wrap_realloc(void* p, size_t size) {
+    allocations++;
+    return __real_realloc(p, size);
+}
+
+void* operator new(size_t size) {
+    allocations++;
+    return __real_malloc(size);
+}
+
+void* operator new[](size_t size) {
+    allocations++;
+    return __real_malloc(size);
+}
+
+void operator delete(void* p) noexcept {
+    free(p);
+}
+
+void operator delete[](void* p) noexcept {
+    free(p);
+}
+
+static void checkData() {
+    uint8_t source[DATA_MAX_SIZE + 8];
+    for (uint8_t i = 0; i < sizeof(source); i++) {
+        source[i] = i;
+    }
+
+    void* heap = sbrk(0);
+    unsigned long before = allocations;
+
+    for (unsigned long cycle = 0; cycle < DATA_CYCLES; cycle++) {
+        uint8_t size = cycle % sizeof(source);
+
+        Data received;
+        bool complete = received.set(cycle, source, size);
+        assert(complete == (size <= DATA_MAX_SIZE));
+        assert(received.getSize() == min(size, DATA_MAX_SIZE));
+
+        Data borrowed;
+        borrowed.borrow(source, size);
+        Data copy(borrowed);
+        assert(copy.isBorrowed() && copy.getData() == source);
+
+        Data moved;
+        moved.move(received);
+        assert(0 == received.getSize() && moved.getAddress() == cycle);
+
+        Data frame = moved;
+        assert(frame.getData() != moved.getData());
+        if (frame.append(source, 2)) {
+            assert(frame.getData()[frame.getSize() - 1] == 1);
+        } else {
+            assert(DATA_MAX_SIZE - 2 < frame.getSize());
+        }
+
+        copy = frame;
+        assert(!copy.isBorrowed() && copy.getSize() == frame.getSize());
+
+        if (0 == cycle % (DATA_CYCLES / SAMPLES)) {
+            printf("Data cycle %8lu: heap top %+ld, allocations %lu\n",
+                   cycle, (long) ((char*) sbrk(0) - (char*) heap), allocations - before);
+        }
+    }
+
+    assert(allocations == before);
+    assert(sbrk(0) == heap);
+}
+
+static void checkWAN() {
+    FakeTransport transport;
+    WAN wan(transport);
+
+    // the fake's own buffers are allocated up front
+    transport.out.reserve(1024);
+
+    Bytes payload;
+    payload.push_back(WAN_MESSAGE_HEADER(1, WAN_MESSAGE_VERSION));
+    payload.push_back(3);
+    payload.push_back(1);
+    payload.push_back(2);
+    payload.push_back(3);
+
+    uint8_t status[] = { ZB_TX_STATUS_RESPONSE, 0, 0x12, 0x34, 0, SUCCESS, 0 };
+
+    void* heap = sbrk(0);
+    unsigned long library = 0;
+
+    for (unsigned long cycle = 0; cycle < WAN_CYCLES; cycle++) {
+        transport.rx(XBEE_BASE_STATION_ADDRESS, payload);
+
+        unsigned long before = allocations;
+        Data data;
+        assert(wan.receive(data));
+        assert(data.getSize() == payload.size());
+
+        uint8_t frameId = wan.transmitAsync(&data);
+        assert(frameId);
+        wan.check();
+        library += allocations - before;
+
+        status[1] = frameId;
+        transport.frame(Bytes(status, status + sizeof(status)));
+        transport.out.clear();
+
+        before = allocations;
+        wan.receiveAll();
+        assert(SUCCESS == wan.getDeliveryStatus(frameId));
+        library += allocations - before;
+
+        if (0 == cycle % (WAN_CYCLES / SAMPLES)) {
+            printf("WAN cycle %9lu: heap top %+ld, allocations %lu\n",
+                   cycle, (long) ((char*) sbrk(0) - (char*) heap), library);
+        }
+    }
+
+    assert(0 == library);
+
+    WANStats stats;
+    wan.getStats(stats);
+    assert(0 == stats.receiveDropped);
+}
+
+// payloads too large for Data are dropped, not returned cut short
+static void checkOversize() {
+    FakeTransport transport;
+    WAN wan(transport);
+
+    transport.rx(XBEE_BASE_STATION_ADDRESS, Bytes(DATA_MAX_SIZE + 1, 0));
+    transport.rx(XBEE_BASE_STATION_ADDRESS, Bytes(DATA_MAX_SIZE, 0));
+
+    Data data;
+    assert(wan.receive(data));
+    assert(DATA_MAX_SIZE == data.getSize());
+    assert(1 == wan.getReceiveDroppedCount());
+    assert(!wan.receive(data));
+}
+
+int main() {
+    checkData();
+    checkWAN();
+    checkOversize();
+
+    return 0;
+}
@@ -0,0 +1,157 @@
+// Frames held for a sleeping node are only sent when it polls for
+// them, followed by an end. The sleeping node only keeps its receive
+// window open after a poll, and closes it as soon as the end arrives.
+
+// system
+#include <assert.h>
+
+// local
+#include "FakeTransport.h"
+#include "WAN.h"
+
+#define SENSOR XBEE_REMOTE_SENSOR_ADDRESS
+#define BASE   XBEE_BASE_STATION_ADDRESS
+
+// payload offset in a ZB TX request (api id onwards)
+#define ZB_TX_PAYLOAD_OFFSET 14
+
+static uint8_t commands = 0;
+
+static void receiveCommand(uint8_t /* type */, Data &/* message */) {
+    commands++;
+}
+
+static Bytes payload(Data &frame) {
+    return Bytes(frame.getData(), frame.getData() + frame.getSize());
+}
+
+// the ZB TX requests sent, acked as delivered
+static std::vector<Bytes> deliver(FakeTransport &transport) {
+    std::vector<Bytes> frames = transport.sent();
+    std::vector<Bytes> payloads;
+
+    for (size_t i = 0; i < frames.size(); i++) {
+        if (ZB_TX_REQUEST == frames[i][0]) {
+            transport.txStatus(frames[i][1], SUCCESS);
+            payloads.push_back(Bytes(frames[i].begin() + ZB_TX_PAYLOAD_OFFSET, frames[i].end()));
+        }
+    }
+
+    return payloads;
+}
+
+// as the remote sensor does after each transmit, how long it
+// stays awake for
+static unsigned long receiveUntilAsleep(WAN &wan, FakeTransport &transport) {
+    unsigned long start = millis();
+
+    Data data;
+    while (wan.isSleepPending()) {
+        deliver(transport);
+        if (wan.receive(data, 10)) {
+            wan.dispatch(data);
+        }
+    }
+
+    return millis() - start;
+}
+
+int main() {
+    fakeTick = 1;
+
+    FakeTransport sensorTransport;
+    WAN sensor(sensorTransport);
+    sensor.enableSleep(17, 16);
+    sensor.setReceiveWindow(WAN_DOWNLINK_WINDOW_MILLIS);
+    sensor.setHandler(5, receiveCommand);
+
+    FakeTransport baseTransport;
+    WAN base(baseTransport);
+
+    uint8_t value = 1;
+
+    Data command;
+    command.setAddress(SENSOR);
+    base.addMessage(command, 5, &value, sizeof(value));
+    assert(base.transmitDownlink(&command));
+    base.check();
+    assert(deliver(baseTransport).empty());
+
+    // a report without a poll: the command stays held, and the
+    // sensor sleeps as soon as it's delivered
+    Data report;
+    report.setAddress(BASE);
+    sensor.addMessage(report, 1, &value, sizeof(value));
+    sensor.transmit(&report);
+    assert(receiveUntilAsleep(sensor, sensorTransport) < WAN_DOWNLINK_WINDOW_MILLIS / 4);
+
+    baseTransport.rx(SENSOR, payload(report));
+    Data data;
+    assert(base.receive(data) && base.dispatch(data) == false);
+    base.check();
+    assert(deliver(baseTransport).empty());
+
+    // with a poll, the command is sent and then the end, at most
+    // one frame per check() as each waits for its TX status
+    assert(sensor.addDownlinkPoll(report));
+    sensor.transmit(&report);
+    deliver(sensorTransport);
+    sensor.receive(data);
+    assert(sensor.isSleepPending());
+
+    baseTransport.rx(SENSOR, payload(report));
+    assert(base.receive(data));
+
+    // queued by a handler for the poll's frame, ahead of the end
+    Data interval;
+    interval.setAddress(SENSOR);
+    value = 2;
+    base.addMessage(interval, 5, &value, sizeof(value));
+    assert(base.transmitDownlink(&interval));
+
+    std::vector<Bytes> downlinks;
+    for (int i = 0; i < 10; i++) {
+        base.check();
+        std::vector<Bytes> sent = deliver(baseTransport);
+        downlinks.insert(downlinks.end(), sent.begin(), sent.end());
+        base.receiveAll();
+    }
+
+    assert(3 == downlinks.size());
+    assert(payload(command) == downlinks[0]);
+    assert(payload(interval) == downlinks[1]);
+    assert(WAN_MESSAGE_HEADER(WAN_MESSAGE_TYPE_DOWNLINK, WAN_MESSAGE_VERSION) == downlinks[2][0]);
+    assert(WAN_DOWNLINK_END == downlinks[2][2]);
+
+    // once the end is sent, later downlinks wait for the next poll
+    assert(base.transmitDownlink(&interval));
+    base.check();
+    assert(deliver(baseTransport).empty());
+
+    // the sensor wakes for them, and sleeps once the end is received
+    // (and the RSSI of it sampled), well before the window passes
+    for (size_t i = 0; i < downlinks.size(); i++) {
+        sensorTransport.rx(BASE, downlinks[i]);
+    }
+
+    Data received;
+    while (sensor.receive(received)) {
+        sensor.dispatch(received);
+    }
+    assert(2 == commands);
+
+    std::vector<Bytes> frames = sensorTransport.sent();
+    for (size_t i = 0; i < frames.size(); i++) {
+        if (AT_COMMAND_REQUEST == frames[i][0]) {
+            sensorTransport.atResponse(frames[i][1], "DB", AT_OK, Bytes(1, 50));
+        }
+    }
+    assert(receiveUntilAsleep(sensor, sensorTransport) < WAN_DOWNLINK_WINDOW_MILLIS / 4);
+
+    // without the end (e.g. it wasn't delivered), the window
+    // closes on its own
+    sensor.transmit(&report);
+    assert(receiveUntilAsleep(sensor, sensorTransport) >= WAN_DOWNLINK_WINDOW_MILLIS / 2);
+
+    return 0;
+}
@@ -0,0 +1,182 @@
+// local
+#include "FakeTransport.h"
+#include "XBee.h"
+
+Bytes apiFrame(const Bytes &frameData, bool escaped) {
+    Bytes raw;
+    raw.push_back(frameData.size() >> 8);
+    raw.push_back(frameData.size() & 0xFF);
+    raw.insert(raw.end(), frameData.begin(), frameData.end());
+
+    uint8_t checksum = 0;
+    for (size_t i = 0; i < frameData.size(); i++) {
+        checksum += frameData[i];
+    }
+    raw.push_back(0xFF - checksum);
+
+    Bytes frame;
+    frame.push_back(START_BYTE);
+    for (size_t i = 0; i < raw.size(); i++) {
+        uint8_t b = raw[i];
+        if (escaped && (START_BYTE == b || ESCAPE == b || XON == b || XOFF == b)) {
+            frame.push_back(ESCAPE);
+            frame.push_back(b ^ 0x20);
+        } else {
+            frame.push_back(b);
+        }
+    }
+
+    return frame;
+}
+
+Bytes recordedTraffic(unsigned seed, int frames, bool errors, bool escaped) {
+    srand(seed);
+
+    Bytes traffic;
+    for (int i = 0; i < frames; i++) {
+        Bytes frameData;
+
+        int kind = rand() % 4;
+        if (kind < 2) {
+            // ZB RX from one of the stations
+            uint8_t header[] = {
+                ZB_RX_RESPONSE, 0x00, 0x13, 0xA2, 0x00, 0x40, 0xC5, 0x99, 0x26, 0x56, 0x78, ZB_PACKET_ACKNOWLEDGED
+            };
+            frameData.assign(header, header + sizeof(header));
+
+            int size = 4 + rand() % 28;
+            for (int j = 0; j < size; j++) {
+                frameData.push_back(rand() % 256);
+            }
+        } else if (kind == 2) {
+            uint8_t status[] = { ZB_TX_STATUS_RESPONSE, (uint8_t) (1 + rand() % 255), 0x12, 0x34, 0, SUCCESS, 0 };
+            frameData.assign(status, status + sizeof(status));
+        } else {
+            uint8_t response[] = { AT_COMMAND_RESPONSE, (uint8_t) (1 + rand() % 255), 'D', 'B', 0, (uint8_t) (rand() % 100) };
+            frameData.assign(response, response + sizeof(response));
+        }
+
+        Bytes frame = apiFrame(frameData, escaped);
+        if (errors && 0 == rand() % 10) {
+            frame.resize(1 + rand() % frame.size());
+        }
+        if (errors && 0 == rand() % 15) {
+            frame[rand() % frame.size()] ^= 1;
+        }
+
+        traffic.insert(traffic.end(), frame.begin(), frame.end());
+    }
+
+    return traffic;
+}
+
+SpanStream::SpanStream(const uint8_t* data, size_t size) : _data(data),
+                                                           _size(size),
+                                                           _pos(0) {
+}
+
+int SpanStream::available() {
+    return _size - _pos;
+}
+
+int SpanStream::read() {
+    return _pos < _size ? _data[_pos++] : -1;
+}
+
+int SpanStream::peek() {
+    return _pos < _size ? _data[_pos] : -1;
+}
+
+void SpanStream::flush() {
+}
+
+size_t SpanStream::write(uint8_t /* b */) {
+    return 0;
+}
+
+FakeTransport::FakeTransport() : baud(0),
+                                 overflows(0) {
+}
+
+void FakeTransport::begin(uint32_t baud) {
+    this->baud = baud;
+}
+
+int FakeTransport::available() {
+    return in.size();
+}
+
+int FakeTransport::read() {
+    if (in.empty()) {
+        return -1;
+    }
+
+    uint8_t b = in.front();
+    in.pop_front();
+    return b;
+}
+
+int FakeTransport::peek() {
+    return in.empty() ? -1 : in.front();
+}
+
+void FakeTransport::flush() {
+}
+
+size_t FakeTransport::write(uint8_t b) {
+    out.push_back(b);
+    return 1;
+}
+
+uint16_t FakeTransport::getOverflowCount() {
+    return overflows;
+}
+
+void FakeTransport::frame(const Bytes &frameData) {
+    Bytes bytes = apiFrame(frameData);
+    in.insert(in.end(), bytes.begin(), bytes.end());
+}
+
+void FakeTransport::txStatus(uint8_t frameId, uint8_t status) {
+    uint8_t frameData[] = { ZB_TX_STATUS_RESPONSE, frameId, 0x12, 0x34, 0, status, 0 };
+    frame(Bytes(frameData, frameData + sizeof(frameData)));
+}
+
+void FakeTransport::atResponse(uint8_t frameId, const char* command, uint8_t status, const Bytes &value) {
+    uint8_t frameData[] = { AT_COMMAND_RESPONSE, frameId, (uint8_t) command[0], (uint8_t) command[1], status };
+    Bytes bytes(frameData, frameData + sizeof(frameData));
+    bytes.insert(bytes.end(), value.begin(), value.end());
+    frame(bytes);
+}
+
+void FakeTransport::rx(uint32_t address, const Bytes &payload) {
+    uint8_t frameData[] = {
+        ZB_RX_RESPONSE,
+        0x00, 0x13, 0xA2, 0x00,
+        (uint8_t) (address >> 24), (uint8_t) (address >> 16), (uint8_t) (address >> 8), (uint8_t) address,
+        0x56, 0x78,
+        ZB_PACKET_ACKNOWLEDGED
+    };
+    Bytes bytes(frameData, frameData + sizeof(frameData));
+    bytes.insert(bytes.end(), payload.begin(), payload.end());
+    frame(bytes);
+}
+
+std::vector<Bytes> FakeTransport::sent() {
+    std::vector<Bytes> frames;
+
+    // a byte at a time, so the XBee's queue never fills
+    XBee xbee;
+    XBeeResponse response;
+    for (size_t i = 0; i < out.size(); i++) {
+        xbee.parse(&out[i], 1);
+        while (xbee.nextPacket(response)) {
+            Bytes bytes(1, response.getApiId());
+            bytes.insert(bytes.end(), response.getFrameData(), response.getFrameData() + response.getFrameDataLength());
+            frames.push_back(bytes);
+        }
+    }
+
+    out.clear();
+    return frames;
+}
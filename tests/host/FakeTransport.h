@@ -0,0 +1,80 @@
+#ifndef FakeTransport_h
+#define FakeTransport_h
+
+// system
+#include <deque>
+#include <vector>
+
+// local
+#include "Transport.h"
+
+typedef std::vector<uint8_t> Bytes;
+
+// Escape and frame an API frame (api id onwards), as the XBee
+// does in API mode 2
+Bytes apiFrame(const Bytes &frameData, bool escaped = true);
+
+// Traffic as the base station sees it: RX frames of packed sensor
+// values, with TX and AT statuses in between. With errors, some
+// frames are cut short or have a byte flipped. The same seed gives
+// the same bytes.
+Bytes recordedTraffic(unsigned seed, int frames, bool errors, bool escaped = true);
+
+/*
+ * A Stream over a span of bytes, to read from without a test's
+ * queue in the way
+ */
+class SpanStream : public Stream {
+    private:
+        const uint8_t* _data;
+        size_t _size;
+        size_t _pos;
+
+    public:
+        SpanStream(const uint8_t* data, size_t size);
+
+        int available();
+        int read();
+        int peek();
+        void flush();
+
+        size_t write(uint8_t b);
+};
+
+/*
+ * A Transport whose received bytes are queued by the test, as
+ * whole XBee API frames or raw bytes, and whose written bytes
+ * are kept for the test to parse.
+ */
+class FakeTransport : public Transport {
+    public:
+        std::deque<uint8_t> in;
+        Bytes out;
+
+        uint32_t baud;
+        uint16_t overflows;
+
+        FakeTransport();
+
+        void begin(uint32_t baud);
+
+        int available();
+        int read();
+        int peek();
+        void flush();
+
+        size_t write(uint8_t b);
+
+        uint16_t getOverflowCount();
+
+        // queue received frames
+        void frame(const Bytes &frameData);
+        void txStatus(uint8_t frameId, uint8_t status);
+        void atResponse(uint8_t frameId, const char* command, uint8_t status, const Bytes &value = Bytes());
+        void rx(uint32_t address, const Bytes &payload);
+
+        // parse the written frames, and clear them
+        std::vector<Bytes> sent();
+};
+
+#endif //FakeTransport_h
@@ -0,0 +1,82 @@
+// flags: -DWAN_PENDING_SIZE=1 -DWAN_DOWNLINK_SIZE=1 -DWAN_COMMANDS_SIZE=3 -DWAN_NODES_SIZE=4 -DWAN_HANDLERS_SIZE=2
+//
+// Message handlers take a slot each, up to WAN_HANDLERS_SIZE types,
+// built with the small tables a sensor sketch uses.
+//
+// Frames which are not exactly messages of this version go to the
+// legacy handler.
+
+// system
+#include <assert.h>
+
+// local
+#include "FakeTransport.h"
+#include "WAN.h"
+
+static uint8_t lastType = 0xFF;
+static uint8_t calls = 0;
+
+static void first(uint8_t type, Data &/* message */) {
+    lastType = type;
+    calls++;
+}
+
+static void second(uint8_t type, Data &/* message */) {
+    lastType = type;
+    calls += 10;
+}
+
+static bool dispatchType(WAN &wan, uint8_t type) {
+    uint8_t value = 1;
+    Data frame;
+    wan.addMessage(frame, type, &value, sizeof(value));
+    return wan.dispatch(frame);
+}
+
+int main() {
+    FakeTransport transport;
+    WAN wan(transport);
+
+    assert(!dispatchType(wan, 3));
+
+    wan.setHandler(3, first);
+    wan.setHandler(5, first);
+    assert(dispatchType(wan, 5) && 5 == lastType && 1 == calls);
+
+    // the table is full, a new type isn't handled
+    wan.setHandler(7, first);
+    assert(!dispatchType(wan, 7));
+
+    // replacing a type's handler keeps its slot
+    wan.setHandler(3, second);
+    assert(dispatchType(wan, 3) && 3 == lastType && 11 == calls);
+
+    // removing one frees its slot
+    wan.setHandler(5, NULL);
+    assert(!dispatchType(wan, 5));
+    wan.setHandler(7, first);
+    assert(dispatchType(wan, 7) && 7 == lastType && 12 == calls);
+
+    // legacy frames (no message headers) too
+    uint8_t legacy[] = { 0xFF, 0xFF, 0xFF };
+    Data frame(legacy, sizeof(legacy));
+    assert(!wan.dispatch(frame));
+    wan.setHandler(7, NULL);
+    wan.setHandler(WAN_MESSAGE_TYPE_LEGACY, second);
+    assert(wan.dispatch(frame) && WAN_MESSAGE_TYPE_LEGACY == lastType && 22 == calls);
+
+    // legacy PumpSwitch settings (50 minutes max on, 1 min on, 5 min
+    // off) look like a header of another version, with a length
+    // that fits
+    wan.setHandler(3, first);
+    uint8_t settings[] = { 0x32, 0x01, 0x05 };
+    Data settingsFrame(settings, sizeof(settings));
+    assert(wan.dispatch(settingsFrame) && WAN_MESSAGE_TYPE_LEGACY == lastType && 32 == calls);
+
+    // or of this version, with lengths not adding up to the frame
+    uint8_t trailing[] = { 0x31, 0x01, 0x05, 0x00 };
+    Data trailingFrame(trailing, sizeof(trailing));
+    assert(wan.dispatch(trailingFrame) && WAN_MESSAGE_TYPE_LEGACY == lastType && 42 == calls);
+
+    return 0;
+}
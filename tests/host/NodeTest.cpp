@@ -0,0 +1,92 @@
+// Nodes start at their hard-coded addresses, and are found by role
+// and instance at wherever they're discovered (node identification
+// or ND) instead, the hard-coded address no longer answering for it.
+
+// system
+#include <assert.h>
+#include <string.h>
+
+// local
+#include "FakeTransport.h"
+#include "WAN.h"
+
+#define NEW_PUMP   0x40A1B2C3UL
+#define OTHER_PUMP 0x40D4E5F6UL
+
+// node identification indicator (0x95) of a node joining:
+//   [SRC64][SRC16][OPTIONS][REMOTE16][REMOTE64][NI...][0]...
+static Bytes nodeIdentifier(uint32_t address, const char* nodeId) {
+    uint8_t address64[] = {
+        0x00, 0x13, 0xA2, 0x00,
+        (uint8_t) (address >> 24), (uint8_t) (address >> 16), (uint8_t) (address >> 8), (uint8_t) address
+    };
+
+    Bytes frame(1, ZB_IO_NODE_IDENTIFIER_RESPONSE);
+    frame.insert(frame.end(), address64, address64 + sizeof(address64));
+    frame.push_back(0x12);
+    frame.push_back(0x34);
+    frame.push_back(0x02);
+    frame.push_back(0x12);
+    frame.push_back(0x34);
+    frame.insert(frame.end(), address64, address64 + sizeof(address64));
+    frame.insert(frame.end(), nodeId, nodeId + strlen(nodeId) + 1);
+
+    return frame;
+}
+
+// ND response value of a node
+static Bytes discovered(uint32_t address, const char* nodeId) {
+    uint8_t value[] = {
+        0x56, 0x78,
+        0x00, 0x13, 0xA2, 0x00,
+        (uint8_t) (address >> 24), (uint8_t) (address >> 16), (uint8_t) (address >> 8), (uint8_t) address
+    };
+
+    Bytes bytes(value, value + sizeof(value));
+    bytes.insert(bytes.end(), nodeId, nodeId + strlen(nodeId) + 1);
+
+    return bytes;
+}
+
+int main() {
+    fakeTick = 1;
+
+    FakeTransport transport;
+    WAN wan(transport);
+
+    // seeded
+    assert(XBEE_PUMP_SWITCH_ADDRESS == wan.getPumpSwitchAddress());
+    assert(XBEE_REMOTE_SENSOR_ADDRESS == wan.getRemoteSensorAddress());
+    assert(1 == wan.getNumNodes(WAN_ROLE_PUMP_SWITCH));
+
+    // the pump switch's XBee was replaced, and joins
+    transport.frame(nodeIdentifier(NEW_PUMP, WAN_NODE_ID_PUMP_SWITCH));
+    wan.receiveAll();
+    assert(NEW_PUMP == wan.getPumpSwitchAddress());
+    assert(WAN_ROLE_PUMP_SWITCH == wan.getRole(NEW_PUMP));
+    assert(WAN_ROLE_UNKNOWN == wan.getRole(XBEE_PUMP_SWITCH_ADDRESS));
+    assert(1 == wan.getNumNodes(WAN_ROLE_PUMP_SWITCH));
+
+    // other roles keep their seeded address
+    assert(XBEE_REMOTE_SENSOR_ADDRESS == wan.getRemoteSensorAddress());
+    assert(XBEE_BASE_STATION_ADDRESS == wan.getBaseStationAddress());
+
+    // a second pump switch is another instance
+    wan.discoverNodes();
+    std::vector<Bytes> frames = transport.sent();
+    assert(1 == frames.size() && AT_COMMAND_REQUEST == frames[0][0]);
+    transport.atResponse(frames[0][1], "ND", AT_OK, discovered(OTHER_PUMP, WAN_NODE_ID_PUMP_SWITCH "1"));
+    wan.receiveAll();
+    assert(NEW_PUMP == wan.getAddress(WAN_ROLE_PUMP_SWITCH, 0));
+    assert(OTHER_PUMP == wan.getAddress(WAN_ROLE_PUMP_SWITCH, 1));
+    assert(2 == wan.getNumNodes(WAN_ROLE_PUMP_SWITCH));
+
+    // and the first moves back to its old XBee
+    transport.atResponse(frames[0][1], "ND", AT_OK, discovered(XBEE_PUMP_SWITCH_ADDRESS, WAN_NODE_ID_PUMP_SWITCH));
+    wan.receiveAll();
+    assert(XBEE_PUMP_SWITCH_ADDRESS == wan.getPumpSwitchAddress());
+    assert(WAN_ROLE_UNKNOWN == wan.getRole(NEW_PUMP));
+    assert(2 == wan.getNumNodes(WAN_ROLE_PUMP_SWITCH));
+
+    return 0;
+}
@@ -0,0 +1,48 @@
+// Timed receives idle (Transport::idle()) until a frame arrives or
+// the timeout passes, frames already waiting are returned at once.
+// The sleep itself is stubbed, time only moves with fakeTick.
+
+// system
+#include <assert.h>
+
+// local
+#include "FakeTransport.h"
+#include "WAN.h"
+
+static uint8_t handled = 0;
+
+static void receiveValue(uint8_t /* type */, Data &/* message */) {
+    handled++;
+}
+
+int main() {
+    fakeTick = 1;
+
+    FakeTransport transport;
+    WAN wan(transport);
+    wan.setHandler(2, receiveValue);
+
+    // nothing arrives: idles until the timeout, and no longer
+    unsigned long start = fakeMillis;
+    assert(0 == wan.receiveAll(5));
+    assert(fakeMillis - start >= 5 && fakeMillis - start < 20);
+
+    // a frame waiting is handled straight away
+    Bytes payload;
+    payload.push_back(WAN_MESSAGE_HEADER(2, WAN_MESSAGE_VERSION));
+    payload.push_back(1);
+    payload.push_back(7);
+    transport.rx(XBEE_REMOTE_SENSOR_ADDRESS, payload);
+
+    start = fakeMillis;
+    assert(1 == wan.receiveAll(1000) && 1 == handled);
+    assert(fakeMillis - start < 20);
+
+    // receive() waits out its timeout too
+    Data data;
+    start = fakeMillis;
+    assert(!wan.receive(data, 50));
+    assert(fakeMillis - start >= 50);
+
+    return 0;
+}
@@ -0,0 +1,50 @@
+// flags: -DXBEE_RX_QUEUE_SIZE=1
+//
+// With a one packet queue (as the remote sensor builds) back-to-back
+// packets wait in the serial buffer instead of being dropped.
+
+// system
+#include <assert.h>
+
+// local
+#include "FakeTransport.h"
+#include "WAN.h"
+
+static uint8_t handled = 0;
+
+static void handle(uint8_t /* type */, Data &/* message */) {
+    handled++;
+}
+
+int main() {
+    FakeTransport transport;
+    WAN wan(transport);
+    wan.setHandler(1, handle);
+
+    Data frame;
+    frame.setAddress(XBEE_BASE_STATION_ADDRESS);
+    uint8_t value = 1;
+    wan.addMessage(frame, 1, &value, sizeof(value));
+
+    uint8_t frameId = wan.transmitAsync(&frame);
+    wan.check();
+
+    // all read at once
+    transport.txStatus(frameId, SUCCESS);
+    transport.rx(XBEE_BASE_STATION_ADDRESS, Bytes(frame.getData(), frame.getData() + frame.getSize()));
+    transport.rx(XBEE_PUMP_SWITCH_ADDRESS, Bytes(frame.getData(), frame.getData() + frame.getSize()));
+    transport.rx(XBEE_PUMP_SWITCH_ADDRESS, Bytes(frame.getData(), frame.getData() + frame.getSize()));
+
+    Data data;
+    assert(wan.receive(data));
+    assert(XBEE_BASE_STATION_ADDRESS == data.getAddress());
+    assert(SUCCESS == wan.getDeliveryStatus(frameId));
+
+    assert(2 == wan.receiveAll());
+    assert(2 == handled);
+
+    assert(0 == wan.getReceiveDroppedCount());
+    assert(0 == transport.available());
+
+    return 0;
+}
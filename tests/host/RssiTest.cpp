@@ -0,0 +1,100 @@
+// The RSSI (DB) of a received frame is only asked for once nothing
+// else is waiting, and credited to its sender by frame id. It's
+// unknown again after WAN_LINK_RSSI_MAX_AGE transmits without one.
+
+// system
+#include <assert.h>
+
+// local
+#include "FakeTransport.h"
+#include "WAN.h"
+
+#define SENSOR XBEE_REMOTE_SENSOR_ADDRESS
+#define PUMP   XBEE_PUMP_SWITCH_ADDRESS
+
+static Bytes message() {
+    Bytes bytes;
+    bytes.push_back(WAN_MESSAGE_HEADER(1, WAN_MESSAGE_VERSION));
+    bytes.push_back(1);
+    bytes.push_back(7);
+    return bytes;
+}
+
+// frame ids of the DB commands sent
+static Bytes rssiRequests(FakeTransport &transport) {
+    Bytes frameIds;
+
+    std::vector<Bytes> frames = transport.sent();
+    for (size_t i = 0; i < frames.size(); i++) {
+        if (AT_COMMAND_REQUEST == frames[i][0] && 'D' == frames[i][2] && 'B' == frames[i][3]) {
+            frameIds.push_back(frames[i][1]);
+        }
+    }
+
+    return frameIds;
+}
+
+int main() {
+    FakeTransport transport;
+    WAN wan(transport);
+
+    // back-to-back frames, only the last one's sender is sampled
+    transport.rx(SENSOR, message());
+    transport.rx(PUMP, message());
+    assert(2 == wan.receiveAll());
+
+    Bytes requests = rssiRequests(transport);
+    assert(1 == requests.size());
+
+    transport.atResponse(requests[0], "DB", AT_OK, Bytes(1, 40));
+    wan.receiveAll();
+    assert(40 == wan.getLinkRssi(PUMP));
+    assert(0 == wan.getLinkRssi(SENSOR));
+    assert(!wan.isCommandPending());
+
+    // a frame received before the response makes it ambiguous, it's
+    // ignored and the new sender sampled instead
+    transport.rx(SENSOR, message());
+    wan.receiveAll();
+    requests = rssiRequests(transport);
+    assert(1 == requests.size());
+
+    transport.rx(PUMP, message());
+    transport.atResponse(requests[0], "DB", AT_OK, Bytes(1, 90));
+    wan.receiveAll();
+    assert(0 == wan.getLinkRssi(SENSOR));
+    assert(40 == wan.getLinkRssi(PUMP));
+
+    requests = rssiRequests(transport);
+    assert(1 == requests.size());
+    transport.atResponse(requests[0], "DB", AT_OK, Bytes(1, 56));
+    wan.receiveAll();
+    assert(42 == wan.getLinkRssi(PUMP));
+    assert(!wan.isCommandPending());
+
+    // transmits to the pump without hearing from it
+    for (uint8_t i = 0; i <= WAN_LINK_RSSI_MAX_AGE; i++) {
+        Data frame;
+        frame.setAddress(PUMP);
+        uint8_t value = i;
+        wan.addMessage(frame, 1, &value, sizeof(value));
+
+        uint8_t frameId = wan.transmitAsync(&frame);
+        wan.check();
+        transport.txStatus(frameId, SUCCESS);
+        wan.receiveAll();
+
+        assert((i < WAN_LINK_RSSI_MAX_AGE ? 42 : 0) == wan.getLinkRssi(PUMP));
+    }
+
+    // and a new sample starts over
+    transport.rx(PUMP, message());
+    wan.receiveAll();
+    requests = rssiRequests(transport);
+    assert(1 == requests.size());
+    transport.atResponse(requests[0], "DB", AT_OK, Bytes(1, 80));
+    wan.receiveAll();
+    assert(80 == wan.getLinkRssi(PUMP));
+
+    return 0;
+}
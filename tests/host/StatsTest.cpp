@@ -0,0 +1,121 @@
+// Link statistics count a scripted exchange (TX failures by status,
+// a bad checksum, a frame cut short), round trip through a
+// WAN_MESSAGE_TYPE_STATS message, and only count time awake.
+
+// system
+#include <assert.h>
+
+// local
+#include "FakeTransport.h"
+#include "WAN.h"
+
+#define BASE XBEE_BASE_STATION_ADDRESS
+
+static Bytes message(uint8_t value) {
+    Bytes bytes;
+    bytes.push_back(WAN_MESSAGE_HEADER(1, WAN_MESSAGE_VERSION));
+    bytes.push_back(1);
+    bytes.push_back(value);
+    return bytes;
+}
+
+static void assertEqual(WANStats &a, WANStats &b) {
+    assert(a.sent == b.sent);
+    assert(a.received == b.received);
+    for (uint8_t i = 0; i < WAN_STATS_TX_FAILURES; i++) {
+        assert(a.txFailures[i] == b.txFailures[i]);
+    }
+    assert(a.checksumErrors == b.checksumErrors);
+    assert(a.startByteErrors == b.startByteErrors);
+    assert(a.receiveDropped == b.receiveDropped);
+    assert(a.transportOverflows == b.transportOverflows);
+    assert(a.wakeMin == b.wakeMin);
+    assert(a.wakeAvg == b.wakeAvg);
+    assert(a.wakeMax == b.wakeMax);
+}
+
+int main() {
+    fakeTick = 1;
+
+    FakeTransport transport;
+    WAN wan(transport);
+
+    Data frame;
+    frame.setAddress(BASE);
+    uint8_t value = 1;
+    wan.addMessage(frame, 1, &value, sizeof(value));
+
+    uint8_t delivered = wan.transmitAsync(&frame);
+    wan.check();
+    uint8_t failed = wan.transmitAsync(&frame);
+    wan.check();
+    uint8_t retried = wan.transmitReliable(&frame);
+    wan.check();
+
+    transport.txStatus(delivered, SUCCESS);
+    transport.txStatus(failed, NETWORK_ACK_FAILURE);
+    transport.txStatus(retried, ROUTE_NOT_FOUND);
+    wan.receiveAll();
+
+    transport.rx(BASE, message(7));
+    transport.rx(BASE, message(8));
+    wan.receiveAll();
+
+    // a corrupt frame (bad checksum), and one cut short
+    const uint8_t corrupt[] = { 0x7e, 0, 3, ZB_RX_RESPONSE, 1, 2, 0 };
+    const uint8_t cutShort[] = { 0x7e, 0, 5, ZB_RX_RESPONSE };
+    transport.in.insert(transport.in.end(), corrupt, corrupt + sizeof(corrupt));
+    transport.in.insert(transport.in.end(), cutShort, cutShort + sizeof(cutShort));
+    transport.rx(BASE, message(9));
+    wan.receiveAll();
+
+    // the retry is sent, then its TX status times out
+    fakeMillis += 20000;
+    wan.check();
+    fakeMillis += 20000;
+    wan.check();
+
+    WANStats stats;
+    wan.getStats(stats);
+    assert(4 == stats.sent && 3 == stats.received);
+    assert(1 == stats.txFailures[WAN_STATS_TX_NETWORK_ACK]);
+    assert(1 == stats.txFailures[WAN_STATS_TX_NOT_FOUND]);
+    assert(1 == stats.txFailures[WAN_STATS_TX_TIMEOUT]);
+    assert(0 == stats.txFailures[WAN_STATS_TX_OTHER]);
+    assert(1 == stats.checksumErrors && 1 == stats.startByteErrors);
+
+    // never slept, awake the whole time
+    assert(0 == stats.wakeMin && 0 == stats.wakeAvg);
+    assert(fakeMillis == stats.awakeMillis);
+
+    // fills a frame, and reads back the same
+    Data statsFrame;
+    statsFrame.setAddress(BASE);
+    assert(wan.addStats(statsFrame));
+    assert(DATA_MAX_SIZE == statsFrame.getSize());
+
+    Data statsMessage(statsFrame.getData() + WAN_MESSAGE_HEADER_SIZE, statsFrame.getData()[1]);
+    WANStats read;
+    assert(wan.readStats(statsMessage, read));
+    assertEqual(read, stats);
+    assert(read.awakeMillis >= stats.awakeMillis);
+
+    Data tooShort(statsFrame.getData() + WAN_MESSAGE_HEADER_SIZE, 10);
+    assert(!wan.readStats(tooShort, read));
+
+    // time asleep isn't counted (CTS is always low here)
+    FakeTransport sleepyTransport;
+    WAN sleepy(sleepyTransport);
+    sleepy.enableSleep(2, 3);
+    sleepy.check();
+
+    fakeMillis += 1000;
+    sleepy.transmit(&frame);
+    sleepy.check();
+
+    WANStats sleepyStats;
+    sleepy.getStats(sleepyStats);
+    assert(sleepyStats.awakeMillis < fakeMillis - 1000 + 20);
+
+    return 0;
+}
@@ -0,0 +1,166 @@
+// Sensor values round trip through the packed and the older
+// byte-per-sensor formats, and through the remote sensor's key and
+// delta frames to the base station: deltas apply in order, one built
+// on a frame the base station missed is rejected until the next key
+// frame resyncs it.
+
+// system
+#include <assert.h>
+#include <string.h>
+
+// local
+#include "TankSensors.h"
+
+static bool same(TankSensors &a, TankSensors &b) {
+    return !memcmp(a.getSensorValues(), b.getSensorValues(), SENSOR_TOTAL_BYTES);
+}
+
+// as the remote sensor reads them from the shift registers
+static void setSensors(TankSensors &sensors, uint8_t b0, uint8_t b1, uint8_t b2) {
+    uint8_t packed[SENSOR_TOTAL_BYTES] = { b0, b1, b2 };
+    Data data(packed, sizeof(packed));
+    sensors.update(data);
+}
+
+// the remote sensor's next frame, delivered to the base station
+// (unless it's lost) and acknowledged
+static uint8_t send(TankSensors &sensor, TankSensors &base, bool keyFrame, bool lost = false) {
+    Data frame;
+    uint8_t type = sensor.getFrame(frame, keyFrame);
+
+    if (!lost) {
+        base.updateFrame(type, frame);
+    }
+    sensor.acknowledge(true);
+
+    return type;
+}
+
+int main() {
+    // packed: sensor N is bit (N % 8) of byte (N / 8)
+    {
+        TankSensors sensors;
+        assert(!sensors.ready());
+
+        setSensors(sensors, 0x01, 0x80, 0x24);
+        assert(sensors.ready());
+        assert(0x01 == sensors.getSensorValues()[0]);
+        assert(0x80 == sensors.getSensorValues()[1]);
+        assert(0x24 == sensors.getSensorValues()[2]);
+
+        // sensor 0 (tank 1's bottom float) is inverted
+        assert(!sensors.getSensorState(TANK_1_INVERTED_FLOAT));
+        assert(sensors.getSensorState(15));
+        assert(sensors.getSensorState(18) && sensors.getSensorState(21));
+        assert(!sensors.getSensorState(1) && !sensors.getSensorState(23));
+    }
+
+    // legacy: a byte per sensor, decodes to the packed values
+    {
+        TankSensors packed;
+        setSensors(packed, 0x01, 0x80, 0x24);
+
+        uint8_t bytes[SENSOR_TOTAL_INPUTS];
+        memset(bytes, 0, sizeof(bytes));
+        bytes[0] = 1;
+        bytes[15] = 1;
+        bytes[18] = 0xFF;
+        bytes[21] = 1;
+
+        TankSensors legacy;
+        Data data(bytes, sizeof(bytes));
+        assert(legacy.isSensorData(data));
+        assert(legacy.update(data));
+        assert(same(packed, legacy));
+
+        // unchanged
+        assert(!legacy.update(data));
+    }
+
+    // sampled pins only change the sensors in the mask
+    {
+        TankSensors sensors;
+        setSensors(sensors, 0xF0, 0x0F, 0xAA);
+        assert(sensors.updateSamples(0x0FF0, 0x0A50));
+        assert(0x50 == sensors.getSensorValues()[0]);
+        assert(0x0A == sensors.getSensorValues()[1]);
+        assert(0xAA == sensors.getSensorValues()[2]);
+    }
+
+    // key frame, then deltas applied in order
+    {
+        TankSensors sensor;
+        TankSensors base;
+
+        setSensors(sensor, 0x01, 0x80, 0x24);
+        assert(MESSAGE_TYPE_SENSOR_KEY == send(sensor, base, false));
+        assert(base.ready() && same(sensor, base));
+
+        setSensors(sensor, 0x03, 0x80, 0x24);
+        assert(MESSAGE_TYPE_SENSOR_DELTA == send(sensor, base, false));
+        assert(base.ready() && same(sensor, base));
+
+        setSensors(sensor, 0x03, 0x00, 0x24);
+        assert(MESSAGE_TYPE_SENSOR_DELTA == send(sensor, base, false));
+        assert(base.ready() && same(sensor, base));
+
+        // nothing changed
+        assert(MESSAGE_TYPE_SENSOR_DELTA == send(sensor, base, false));
+        assert(base.ready() && same(sensor, base));
+
+        // a delta wouldn't be any smaller
+        setSensors(sensor, 0x00, 0x01, 0x24);
+        assert(MESSAGE_TYPE_SENSOR_KEY == send(sensor, base, false));
+        assert(base.ready() && same(sensor, base));
+    }
+
+    // a missed frame: the next delta is rejected and the values are
+    // unknown, until a key frame resyncs them
+    {
+        TankSensors sensor;
+        TankSensors base;
+
+        setSensors(sensor, 0x01, 0x80, 0x24);
+        send(sensor, base, true);
+
+        setSensors(sensor, 0x03, 0x80, 0x24);
+        assert(MESSAGE_TYPE_SENSOR_DELTA == send(sensor, base, false, true));
+
+        setSensors(sensor, 0x07, 0x80, 0x24);
+        Data frame;
+        assert(MESSAGE_TYPE_SENSOR_DELTA == sensor.getFrame(frame, false));
+        assert(!base.updateFrame(MESSAGE_TYPE_SENSOR_DELTA, frame));
+        assert(!base.ready());
+        sensor.acknowledge(true);
+
+        // later deltas too, only a key frame is trusted
+        assert(MESSAGE_TYPE_SENSOR_DELTA == send(sensor, base, false));
+        assert(!base.ready());
+
+        assert(MESSAGE_TYPE_SENSOR_KEY == send(sensor, base, true));
+        assert(base.ready() && same(sensor, base));
+
+        setSensors(sensor, 0x06, 0x80, 0x24);
+        assert(MESSAGE_TYPE_SENSOR_DELTA == send(sensor, base, false));
+        assert(base.ready() && same(sensor, base));
+    }
+
+    // an undelivered frame: the next is a key frame
+    {
+        TankSensors sensor;
+        TankSensors base;
+
+        setSensors(sensor, 0x01, 0x80, 0x24);
+        send(sensor, base, true);
+
+        setSensors(sensor, 0x03, 0x80, 0x24);
+        Data frame;
+        assert(MESSAGE_TYPE_SENSOR_DELTA == sensor.getFrame(frame, false));
+        sensor.acknowledge(false);
+
+        assert(MESSAGE_TYPE_SENSOR_KEY == send(sensor, base, false));
+        assert(base.ready() && same(sensor, base));
+    }
+
+    return 0;
+}
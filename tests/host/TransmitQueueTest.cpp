@@ -0,0 +1,176 @@
+// Queued transmits are sent highest priority first (then oldest), a
+// full queue drops a lower priority transmit not yet sent, and a
+// queued frame of state messages is replaced by a later one to the
+// same node repeating them all, keeping its frame id.
+
+// system
+#include <assert.h>
+
+// local
+#include "FakeTransport.h"
+#include "WAN.h"
+
+#define BASE XBEE_BASE_STATION_ADDRESS
+#define PUMP XBEE_PUMP_SWITCH_ADDRESS
+
+// a ZB TX request's payload offset (api id onwards), and the value
+// of its first message
+#define ZB_TX_PAYLOAD_OFFSET 14
+#define FIRST_VALUE_OFFSET   (ZB_TX_PAYLOAD_OFFSET + WAN_MESSAGE_HEADER_SIZE)
+
+struct Delivery {
+    uint8_t  frameId;
+    uint32_t address;
+    uint8_t  status;
+};
+
+static std::vector<Delivery> deliveries;
+
+static void onDelivery(uint8_t frameId, uint32_t address, uint8_t status) {
+    Delivery delivery = { frameId, address, status };
+    deliveries.push_back(delivery);
+}
+
+// frame id and first message value of each ZB TX request sent
+static std::vector<std::pair<uint8_t, uint8_t> > sent(FakeTransport &transport) {
+    std::vector<std::pair<uint8_t, uint8_t> > transmits;
+
+    std::vector<Bytes> frames = transport.sent();
+    for (size_t i = 0; i < frames.size(); i++) {
+        if (ZB_TX_REQUEST == frames[i][0]) {
+            transmits.push_back(std::make_pair(frames[i][1], frames[i][FIRST_VALUE_OFFSET]));
+        }
+    }
+
+    return transmits;
+}
+
+static Data message(WAN &wan, uint32_t address, uint8_t type, uint8_t value) {
+    Data frame;
+    frame.setAddress(address);
+    wan.addMessage(frame, type, &value, sizeof(value));
+    return frame;
+}
+
+int main() {
+    fakeTick = 1;
+
+    // send order, and a state message coalesced into an earlier one
+    {
+        FakeTransport transport;
+        WAN wan(transport);
+        wan.setStateMessage(3);
+
+        Data a = message(wan, BASE, 1, 10);
+        Data b = message(wan, PUMP, 3, 20);
+        Data c = message(wan, PUMP, 3, 21);
+        Data d = message(wan, BASE, 4, 30);
+
+        uint8_t idA = wan.transmitAsync(&a, WAN_PRIORITY_LOW);
+        uint8_t idB = wan.transmitAsync(&b);
+        assert(idB == wan.transmitReliable(&c, WAN_PRIORITY_HIGH));
+        uint8_t idD = wan.transmitAsync(&d);
+        assert(idD && idD != idA);
+
+        wan.check();
+        std::vector<std::pair<uint8_t, uint8_t> > transmits = sent(transport);
+        assert(3 == transmits.size());
+        assert(idB == transmits[0].first && 21 == transmits[0].second);
+        assert(idD == transmits[1].first);
+        assert(idA == transmits[2].first);
+    }
+
+    // other types, and frames with types not repeated, aren't coalesced
+    {
+        FakeTransport transport;
+        WAN wan(transport);
+        wan.setStateMessage(3);
+
+        Data a = message(wan, PUMP, 4, 1);
+        Data b = message(wan, PUMP, 4, 2);
+        assert(wan.transmitAsync(&a) != wan.transmitAsync(&b));
+
+        uint8_t value = 'x';
+        Data c = message(wan, BASE, 3, 1);
+        wan.addMessage(c, 4, &value, sizeof(value));
+        Data d = message(wan, BASE, 3, 2);
+
+        // c isn't only state messages, and the queue is now full
+        assert(wan.transmitAsync(&c));
+        assert(!wan.transmitAsync(&d));
+    }
+
+    // a later frame repeating every state message replaces it, only
+    // for the same node
+    {
+        FakeTransport transport;
+        WAN wan(transport);
+        wan.setStateMessage(3);
+        wan.setStateMessage(4);
+
+        uint8_t value = 'x';
+        Data c = message(wan, BASE, 3, 1);
+        wan.addMessage(c, 4, &value, sizeof(value));
+        Data d = message(wan, BASE, 3, 2);
+
+        uint8_t id = wan.transmitAsync(&d);
+        assert(id == wan.transmitAsync(&c));
+
+        Data e = message(wan, PUMP, 3, 2);
+        assert(id != wan.transmitAsync(&e));
+    }
+
+    // a full queue drops the lowest priority transmit for a higher one
+    {
+        FakeTransport transport;
+        WAN wan(transport);
+        wan.setDeliveryCallback(onDelivery);
+
+        Data a = message(wan, BASE, 1, 1);
+        Data b = message(wan, BASE, 2, 2);
+        Data c = message(wan, BASE, 4, 3);
+        Data d = message(wan, BASE, 5, 4);
+
+        uint8_t idA = wan.transmitAsync(&a, WAN_PRIORITY_LOW);
+        uint8_t idB = wan.transmitAsync(&b, WAN_PRIORITY_NORMAL);
+        uint8_t idC = wan.transmitAsync(&c, WAN_PRIORITY_LOW);
+        assert(!wan.transmitAsync(&d, WAN_PRIORITY_LOW));
+
+        uint8_t idD = wan.transmitAsync(&d, WAN_PRIORITY_HIGH);
+        assert(idD);
+        assert(1 == deliveries.size());
+        assert(idA == deliveries[0].frameId && BASE == deliveries[0].address);
+        assert(WAN_DELIVERY_DROPPED == deliveries[0].status);
+
+        wan.check();
+        std::vector<std::pair<uint8_t, uint8_t> > transmits = sent(transport);
+        assert(3 == transmits.size());
+        assert(idD == transmits[0].first && idB == transmits[1].first && idC == transmits[2].first);
+    }
+
+    // a state transmit in flight isn't replaced, once it's waiting
+    // to be retried it is
+    {
+        FakeTransport transport;
+        WAN wan(transport);
+        wan.setStateMessage(3);
+
+        Data a = message(wan, PUMP, 3, 1);
+        Data b = message(wan, PUMP, 3, 2);
+
+        uint8_t idA = wan.transmitReliable(&a);
+        wan.check();
+        sent(transport);
+        assert(idA != wan.transmitAsync(&b));
+
+        transport.txStatus(idA, NETWORK_ACK_FAILURE);
+        wan.receiveAll();
+        wan.check();
+        assert(1 == sent(transport).size());
+
+        Data c = message(wan, PUMP, 3, 3);
+        assert(idA == wan.transmitAsync(&c));
+    }
+
+    return 0;
+}
@@ -0,0 +1,78 @@
+// flags: -DXBEE_RX_QUEUE_SIZE=1
+//
+// Size and parse time of the same ZB TX request framed in API mode 1
+// (unescaped) and 2 (escaped), with a payload of packed sensor bytes
+// where 4 of every 6 need escaping. Each frame is checked to parse
+// back to what was sent.
+
+// system
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+
+// local
+#include "FakeTransport.h"
+#include "XBee.h"
+
+#define PAYLOAD_SIZE 24
+#define FRAMES       100000
+
+// ZB TX request frame data before the payload, after the api id
+#define ZB_TX_HEADER_SIZE 13
+
+typedef std::chrono::steady_clock Clock;
+
+static void benchmark(uint8_t apiMode) {
+    const uint8_t packed[] = { 0x7e, 0x11, 0x13, 0x7d, 0x01, 0x42 };
+
+    uint8_t payload[PAYLOAD_SIZE];
+    for (uint8_t i = 0; i < PAYLOAD_SIZE; i++) {
+        payload[i] = packed[i % sizeof(packed)];
+    }
+
+    FakeTransport transport;
+    XBee xbee;
+    xbee.setSerial(transport);
+    xbee.setApiMode(apiMode);
+
+    // the base station
+    XBeeAddress64 address = XBeeAddress64(0x0013A200, 0x40C59926);
+    ZBTxRequest zbTx = ZBTxRequest(address, payload, PAYLOAD_SIZE);
+    zbTx.setFrameId(1);
+    xbee.send(zbTx);
+
+    const Bytes frame = transport.out;
+
+    // parses back to the same request
+    XBee parser;
+    parser.setApiMode(apiMode);
+    XBeeResponse response;
+
+    assert(1 == parser.parse(frame.data(), frame.size()));
+    assert(parser.nextPacket(response));
+    assert(ZB_TX_REQUEST == response.getApiId());
+    assert(ZB_TX_HEADER_SIZE + PAYLOAD_SIZE == response.getFrameDataLength());
+    assert(!memcmp(response.getFrameData() + ZB_TX_HEADER_SIZE, payload, PAYLOAD_SIZE));
+
+    unsigned long frames = 0;
+
+    Clock::time_point start = Clock::now();
+    for (int i = 0; i < FRAMES; i++) {
+        frames += parser.parse(frame.data(), frame.size());
+
+        while (parser.nextPacket(response)) {
+        }
+    }
+    double nanos = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+
+    assert(FRAMES == frames);
+    printf("AP=%d  %3zu frame bytes  %8.1f ns/frame parse\n", apiMode, frame.size(), nanos / FRAMES);
+}
+
+int main() {
+    benchmark(1);
+    benchmark(2);
+
+    return 0;
+}
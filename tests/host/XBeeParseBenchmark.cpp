@@ -0,0 +1,77 @@
+// flags: -DXBEE_RX_QUEUE_SIZE=16
+//
+// Throughput of readPacket() (a virtual Stream call per byte) and
+// XBee::parse() over spans, on the same recorded traffic. The queue
+// is large enough for every packet completed by one span.
+
+// system
+#include <assert.h>
+#include <stdio.h>
+#include <chrono>
+
+// local
+#include "FakeTransport.h"
+#include "XBee.h"
+
+#define FRAMES  20000
+#define REPEATS 20
+
+typedef std::chrono::steady_clock Clock;
+
+static void report(const char* name, size_t bytes, unsigned long frames, Clock::time_point start) {
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+    printf("%-22s %8.1f MB/s %10.0f frames/s\n", name, bytes * REPEATS / seconds / 1e6, frames / seconds);
+}
+
+static void readEach(const Bytes &traffic) {
+    unsigned long frames = 0;
+
+    Clock::time_point start = Clock::now();
+    for (int i = 0; i < REPEATS; i++) {
+        SpanStream stream(traffic.data(), traffic.size());
+        XBee xbee;
+        xbee.setSerial(stream);
+
+        while (stream.available()) {
+            xbee.readPacket();
+            frames += xbee.getResponse().isAvailable();
+        }
+    }
+
+    assert(FRAMES * REPEATS == frames);
+    report("readPacket()", traffic.size(), frames, start);
+}
+
+static void parseSpans(const Bytes &traffic, size_t span, const char* name) {
+    unsigned long frames = 0;
+    XBeeResponse response;
+
+    Clock::time_point start = Clock::now();
+    for (int i = 0; i < REPEATS; i++) {
+        XBee xbee;
+
+        for (size_t pos = 0; pos < traffic.size(); pos += span) {
+            size_t size = min(span, traffic.size() - pos);
+            xbee.parse(&traffic[pos], size);
+
+            while (xbee.nextPacket(response)) {
+                frames++;
+            }
+        }
+    }
+
+    assert(FRAMES * REPEATS == frames);
+    report(name, traffic.size(), frames, start);
+}
+
+int main() {
+    Bytes traffic = recordedTraffic(1, FRAMES, false);
+    printf("%d frames, %zu bytes\n", FRAMES, traffic.size());
+
+    readEach(traffic);
+    parseSpans(traffic, 16, "parse(), 16 byte spans");
+    parseSpans(traffic, 64, "parse(), 64 byte spans");
+
+    return 0;
+}
@@ -0,0 +1,88 @@
+// flags: -DXBEE_RX_QUEUE_SIZE=16
+//
+// XBee::parse() over spans of any size produces the same packets,
+// and counts the same errors, as readPacket() a byte at a time.
+
+// system
+#include <assert.h>
+#include <stdio.h>
+
+// local
+#include "FakeTransport.h"
+#include "XBee.h"
+
+typedef std::vector<Bytes> Packets;
+
+static Bytes packet(XBeeResponse &response) {
+    Bytes bytes(1, response.getApiId());
+    bytes.insert(bytes.end(), response.getFrameData(), response.getFrameData() + response.getFrameDataLength());
+    return bytes;
+}
+
+static Packets readEach(const Bytes &traffic, uint16_t &errors) {
+    Packets packets;
+
+    SpanStream stream(traffic.data(), traffic.size());
+    XBee xbee;
+    xbee.setSerial(stream);
+
+    while (stream.available()) {
+        xbee.readPacket();
+        if (xbee.getResponse().isAvailable()) {
+            packets.push_back(packet(xbee.getResponse()));
+        } else if (xbee.getResponse().isError()) {
+            errors++;
+        }
+    }
+
+    return packets;
+}
+
+static Packets parseSpans(const Bytes &traffic, size_t maxSpan, uint16_t &errors) {
+    Packets packets;
+
+    XBee xbee;
+    XBeeResponse response;
+    for (size_t pos = 0; pos < traffic.size(); ) {
+        size_t size = 1 + rand() % maxSpan;
+        size = min(size, traffic.size() - pos);
+        xbee.parse(&traffic[pos], size);
+        pos += size;
+
+        while (xbee.nextPacket(response)) {
+            packets.push_back(packet(response));
+        }
+    }
+
+    assert(0 == xbee.getQueueOverflowCount());
+    errors = xbee.getPacketErrorCount();
+
+    return packets;
+}
+
+int main() {
+    for (unsigned seed = 1; seed <= 20; seed++) {
+        Bytes traffic = recordedTraffic(seed, 500, 0 != seed % 2);
+
+        uint16_t readErrors = 0;
+        Packets read = readEach(traffic, readErrors);
+
+        // the largest never holds more packets than the queue
+        size_t spans[] = { 1, 7, 64, 150 };
+        for (uint8_t i = 0; i < sizeof(spans) / sizeof(spans[0]); i++) {
+            uint16_t parseErrors = 0;
+            Packets parsed = parseSpans(traffic, spans[i], parseErrors);
+
+            assert(read == parsed);
+            assert(readErrors == parseErrors);
+        }
+
+        if (0 == seed % 2) {
+            assert(500 == read.size() && 0 == readErrors);
+        } else {
+            assert(read.size() < 500 && readErrors);
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,71 @@
+#!/bin/bash
+#
+# Build the libraries against the stubs in stubs/ and run every
+# *Test.cpp and *Benchmark.cpp here (or just the ones named), then
+# check the sketches compile against the same stubs.
+#
+#   tests/host/run.sh [name ...]
+#
+# A test's extra compiler flags are on a "// flags:" line.
+
+HOST=$(cd "$(dirname "$0")" && pwd)
+REPO=$(cd "$HOST/../.." && pwd)
+BUILD=$HOST/build
+
+CXX=${CXX:-g++}
+CXXFLAGS="-std=gnu++11 -O2 -g"
+
+# the libraries, tests and stubs must build without warnings, the
+# stub headers are system headers so Arduino's own quirks (e.g.
+# unused registers) don't count
+WARNINGS="-Wall -Wextra -Werror"
+
+LIBRARIES="Danaides Data LED TankSensors Transport WAN XBee"
+
+INCLUDES="-I$HOST -isystem $HOST/stubs"
+SOURCES="$HOST/stubs/Arduino.cpp $HOST/FakeTransport.cpp"
+for library in $LIBRARIES; do
+    INCLUDES="$INCLUDES -I$REPO/libraries/$library"
+    SOURCES="$SOURCES $(ls $REPO/libraries/$library/*.cpp | grep -v Danaides.cpp)"
+done
+
+mkdir -p "$BUILD"
+
+if [ $# -eq 0 ]; then
+    set -- $(cd "$HOST" && ls *Test.cpp *Benchmark.cpp 2>/dev/null | sed 's/\.cpp$//')
+fi
+
+failed=0
+for name in "$@"; do
+    flags=$(sed -n 's|^// flags: *||p' "$HOST/$name.cpp")
+
+    if ! $CXX $CXXFLAGS $WARNINGS $flags $INCLUDES "$HOST/$name.cpp" $SOURCES -o "$BUILD/$name"; then
+        echo "FAIL $name (build)"
+        failed=1
+    elif ! "$BUILD/$name"; then
+        echo "FAIL $name"
+        failed=1
+    else
+        echo "ok   $name"
+    fi
+done
+
+# the sketches only need to compile, with each sketch's ino.ini flags
+# (and ino's -w, the third party libraries they include aren't clean)
+for sketch in base-station pump-switch remote-sensor; do
+    flags=$(sed -n 's|^cppflags *= *||p' "$REPO/$sketch/ino.ini" | grep -o -- '-D[^ ]*')
+    includes="-I$HOST/stubs"
+    for library in "$REPO"/libraries/*/; do
+        includes="$includes -I$library"
+    done
+
+    if ! $CXX $CXXFLAGS -w $flags -fsyntax-only -x c++ -include Arduino.h $includes "$REPO/$sketch/src/$sketch.ino" 2>&1 \
+            | grep "error" | grep -v "Adafruit"; then
+        echo "ok   $sketch"
+    else
+        echo "FAIL $sketch (build)"
+        failed=1
+    fi
+done
+
+exit $failed
@@ -0,0 +1,229 @@
+// system
+#include <stdarg.h>
+#include <stdio.h>
+
+// local
+#include "Arduino.h"
+#include "SoftwareSerial.h"
+#include "Wire.h"
+
+// status register, only saved and restored
+uint8_t SREG = 0;
+
+/*
+ * Time
+ */
+
+unsigned long fakeMillis = 0;
+unsigned long fakeTick = 0;
+
+unsigned long millis() {
+    fakeMillis += fakeTick;
+    return fakeMillis;
+}
+
+unsigned long micros() {
+    return millis() * 1000UL;
+}
+
+void delay(unsigned long ms) {
+    fakeMillis += ms;
+}
+
+void delayMicroseconds(unsigned int /* us */) {
+}
+
+/*
+ * Pins
+ */
+
+void pinMode(uint8_t /* pin */, uint8_t /* mode */) {
+}
+
+void digitalWrite(uint8_t /* pin */, uint8_t /* value */) {
+}
+
+int digitalRead(uint8_t /* pin */) {
+    return LOW;
+}
+
+void attachInterrupt(uint8_t /* interrupt */, void (*/* isr */)(), int /* mode */) {
+}
+
+/*
+ * Print
+ */
+
+static size_t printf(Print* print, const char* format, ...) __attribute__((format(printf, 2, 3)));
+
+static size_t printf(Print* print, const char* format, ...) {
+    char buffer[64];
+
+    va_list args;
+    va_start(args, format);
+    int size = vsnprintf(buffer, sizeof(buffer), format, args);
+    va_end(args);
+
+    return print->write((const uint8_t*) buffer, min((size_t) size, sizeof(buffer) - 1));
+}
+
+size_t Print::write(const uint8_t *buffer, size_t size) {
+    size_t written = 0;
+    while (size--) {
+        written += write(*buffer++);
+    }
+
+    return written;
+}
+
+size_t Print::print(const char* s) {
+    return write((const uint8_t*) s, strlen(s));
+}
+
+size_t Print::print(int v, int base) {
+    return print((long) v, base);
+}
+
+size_t Print::print(unsigned int v, int base) {
+    return print((unsigned long) v, base);
+}
+
+size_t Print::print(long v, int base) {
+    return printf(this, HEX == base ? "%lX" : "%ld", v);
+}
+
+size_t Print::print(unsigned long v, int base) {
+    return printf(this, HEX == base ? "%lX" : "%lu", v);
+}
+
+size_t Print::print(double v, int digits) {
+    return printf(this, "%.*f", digits, v);
+}
+
+size_t Print::println(const char* s) {
+    return print(s) + println();
+}
+
+size_t Print::println(int v, int base) {
+    return print(v, base) + println();
+}
+
+size_t Print::println(unsigned int v, int base) {
+    return print(v, base) + println();
+}
+
+size_t Print::println(long v, int base) {
+    return print(v, base) + println();
+}
+
+size_t Print::println(unsigned long v, int base) {
+    return print(v, base) + println();
+}
+
+size_t Print::println(double v, int digits) {
+    return print(v, digits) + println();
+}
+
+size_t Print::println() {
+    return print("\r\n");
+}
+
+/*
+ * HardwareSerial
+ */
+
+HardwareSerial Serial;
+
+void HardwareSerial::begin(unsigned long /* baud */) {
+}
+
+void HardwareSerial::end() {
+}
+
+size_t HardwareSerial::write(uint8_t b) {
+    static bool verbose = getenv("HOST_TEST_VERBOSE");
+    if (verbose && '\r' != b) {
+        putchar(b);
+    }
+
+    return 1;
+}
+
+int HardwareSerial::available() {
+    return 0;
+}
+
+int HardwareSerial::read() {
+    return -1;
+}
+
+int HardwareSerial::peek() {
+    return -1;
+}
+
+void HardwareSerial::flush() {
+}
+
+/*
+ * SoftwareSerial
+ */
+
+SoftwareSerial::SoftwareSerial(uint8_t /* rx */, uint8_t /* tx */, bool /* inverse */) {
+}
+
+void SoftwareSerial::begin(long /* baud */) {
+}
+
+void SoftwareSerial::end() {
+}
+
+bool SoftwareSerial::listen() {
+    return true;
+}
+
+bool SoftwareSerial::isListening() {
+    return true;
+}
+
+bool SoftwareSerial::overflow() {
+    return false;
+}
+
+size_t SoftwareSerial::write(uint8_t /* b */) {
+    return 1;
+}
+
+int SoftwareSerial::available() {
+    return 0;
+}
+
+int SoftwareSerial::read() {
+    return -1;
+}
+
+int SoftwareSerial::peek() {
+    return -1;
+}
+
+void SoftwareSerial::flush() {
+}
+
+/*
+ * TwoWire
+ */
+
+TwoWire Wire;
+
+void TwoWire::begin() {
+}
+
+void TwoWire::beginTransmission(uint8_t /* address */) {
+}
+
+uint8_t TwoWire::endTransmission() {
+    return 0;
+}
+
+size_t TwoWire::write(uint8_t /* b */) {
+    return 1;
+}
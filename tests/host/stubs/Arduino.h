@@ -0,0 +1,122 @@
+#ifndef Arduino_h
+#define Arduino_h
+
+// Just enough of the Arduino core to build the libraries on
+// the host, see tests/host/README.md
+
+#include <ctype.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+// the standard headers the tests use, before min() and max()
+// are defined as macros
+#include <algorithm>
+#include <deque>
+#include <vector>
+
+#define ARDUINO 105
+
+#define HIGH 1
+#define LOW  0
+
+#define INPUT        0
+#define OUTPUT       1
+#define INPUT_PULLUP 2
+
+#define CHANGE 1
+
+#define HEX 16
+
+#define PROGMEM
+#define F(s) (s)
+#define PSTR(s) (s)
+#define pgm_read_byte(p) (*(const uint8_t*) (p))
+#define pgm_read_dword(p) (*(const uint32_t*) (p))
+#define memcpy_P memcpy
+#define strncmp_P strncmp
+
+#define bitRead(v, b) (((v) >> (b)) & 1)
+#define bitSet(v, b) ((v) |= (1UL << (b)))
+#define bitClear(v, b) ((v) &= ~(1UL << (b)))
+#define bitWrite(v, b, x) ((x) ? bitSet(v, b) : bitClear(v, b))
+
+#define min(a, b) ((a) < (b) ? (a) : (b))
+#define max(a, b) ((a) > (b) ? (a) : (b))
+#define constrain(a, l, h) ((a) < (l) ? (l) : ((a) > (h) ? (h) : (a)))
+
+#define noInterrupts()
+#define interrupts()
+#define cli()
+#define sei()
+
+#define digitalPinToPCICR(p) ((volatile uint8_t*) 0)
+
+typedef bool boolean;
+typedef uint8_t byte;
+
+extern uint8_t SREG;
+
+// millis() advances by fakeTick on every call, and by the
+// whole period on delay(), so timeouts end without waiting
+extern unsigned long fakeMillis;
+extern unsigned long fakeTick;
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t value);
+int digitalRead(uint8_t pin);
+void attachInterrupt(uint8_t interrupt, void (*isr)(), int mode);
+
+class Print {
+    public:
+        virtual size_t write(uint8_t b) = 0;
+        virtual size_t write(const uint8_t *buffer, size_t size);
+
+        size_t print(const char* s);
+        size_t print(int v, int base = 10);
+        size_t print(unsigned int v, int base = 10);
+        size_t print(long v, int base = 10);
+        size_t print(unsigned long v, int base = 10);
+        size_t print(double v, int digits = 2);
+
+        size_t println(const char* s);
+        size_t println(int v, int base = 10);
+        size_t println(unsigned int v, int base = 10);
+        size_t println(long v, int base = 10);
+        size_t println(unsigned long v, int base = 10);
+        size_t println(double v, int digits = 2);
+        size_t println();
+};
+
+class Stream : public Print {
+    public:
+        virtual int available() = 0;
+        virtual int read() = 0;
+        virtual int peek() = 0;
+        virtual void flush() = 0;
+};
+
+// Serial logs to stdout when HOST_TEST_VERBOSE is set
+class HardwareSerial : public Stream {
+    public:
+        void begin(unsigned long baud);
+        void end();
+
+        size_t write(uint8_t b);
+        int available();
+        int read();
+        int peek();
+        void flush();
+
+        using Print::write;
+};
+
+extern HardwareSerial Serial;
+
+#endif //Arduino_h
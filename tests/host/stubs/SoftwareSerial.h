@@ -0,0 +1,26 @@
+#ifndef SoftwareSerial_h
+#define SoftwareSerial_h
+
+#include "Arduino.h"
+
+// A port that never receives anything
+class SoftwareSerial : public Stream {
+    public:
+        SoftwareSerial(uint8_t rx, uint8_t tx, bool inverse = false);
+
+        void begin(long baud);
+        void end();
+        bool listen();
+        bool isListening();
+        bool overflow();
+
+        size_t write(uint8_t b);
+        int available();
+        int read();
+        int peek();
+        void flush();
+
+        using Print::write;
+};
+
+#endif //SoftwareSerial_h
@@ -0,0 +1,16 @@
+#ifndef Wire_h
+#define Wire_h
+
+#include "Arduino.h"
+
+class TwoWire {
+    public:
+        void begin();
+        void beginTransmission(uint8_t address);
+        uint8_t endTransmission();
+        size_t write(uint8_t b);
+};
+
+extern TwoWire Wire;
+
+#endif //Wire_h
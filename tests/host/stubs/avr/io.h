@@ -0,0 +1 @@
+// empty, see tests/host/stubs/Arduino.h
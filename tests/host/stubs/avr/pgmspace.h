@@ -0,0 +1 @@
+// PROGMEM is defined in tests/host/stubs/Arduino.h
@@ -0,0 +1,13 @@
+#ifndef sleep_h
+#define sleep_h
+
+// the MCU never sleeps on the host
+
+#define SLEEP_MODE_IDLE 0
+
+#define set_sleep_mode(mode)
+#define sleep_enable()
+#define sleep_disable()
+#define sleep_cpu()
+
+#endif //sleep_h